@@ -0,0 +1,111 @@
+#include "emulator_context.h"
+#include "input_provider.h"
+#include "interpreter.h"
+#include "memory.h"
+
+#include "batch_executor.h"
+
+BatchExecutor::BatchExecutor(int threadCount) :
+  _threadCount(qMax(threadCount, 1)),
+  _jobs(0),
+  _results(0)
+{
+}
+
+QVector<BatchResult> BatchExecutor::run(const QList<BatchJob> &jobs)
+{
+  QVector<BatchResult> results(jobs.count());
+  int threadCount = qMin(_threadCount, jobs.count());
+  if (!threadCount)
+    return results;
+
+  _jobs = &jobs;
+  _results = results.data(); // Detached here, the workers write distinct items
+
+  // Contiguous slices: neighbour jobs often have similar costs, stealing evens it out
+  for (int i = 0; i < threadCount; ++i)
+  {
+    JobDeque *deque = new JobDeque;
+    int first = jobs.count() * i / threadCount;
+    int last = jobs.count() * (i + 1) / threadCount;
+    for (int job = first; job < last; ++job)
+      deque->jobs << job;
+    _deques << deque;
+  }
+
+  QList<Worker *> workers;
+  for (int i = 0; i < threadCount; ++i)
+  {
+    workers << new Worker(this, i);
+    workers.last()->start();
+  }
+  foreach (Worker *worker, workers)
+  {
+    worker->wait();
+    delete worker;
+  }
+
+  qDeleteAll(_deques);
+  _deques.clear();
+  _jobs = 0;
+  _results = 0;
+  return results;
+}
+
+int BatchExecutor::takeJob(int workerIndex)
+{
+  {
+    JobDeque *own = _deques[workerIndex];
+    QMutexLocker locker(&own->mutex);
+    if (!own->jobs.isEmpty())
+      return own->jobs.takeLast();
+  }
+
+  // Steal from the others, the oldest job first
+  for (int i = 1; i < _deques.count(); ++i)
+  {
+    JobDeque *victim = _deques[(workerIndex + i) % _deques.count()];
+    QMutexLocker locker(&victim->mutex);
+    if (!victim->jobs.isEmpty())
+      return victim->jobs.takeFirst();
+  }
+  return -1;
+}
+
+void BatchExecutor::Worker::run()
+{
+  int job;
+  while ((job = _executor->takeJob(_index)) >= 0)
+    _executor->_results[job] = runJob(_executor->_jobs->at(job));
+}
+
+BatchResult BatchExecutor::runJob(const BatchJob &job)
+{
+  EmulatorContext context(job.randomSeed);
+  QMapIterator<int, QList<TextLine> > i(job.programAreas);
+  while (i.hasNext())
+  {
+    i.next();
+    if (i.key() >= 0 && i.key() < Memory::programsCount)
+      context.memory().programAt(i.key())->setSteps(i.value());
+  }
+
+  QueueInputProvider inputs(job.inputs);
+  Interpreter interpreter(job.program, context);
+  interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+  interpreter.setInputProvider(&inputs);
+  interpreter.setStepBudget(job.stepBudget);
+  interpreter.setDeadline(job.deadline);
+  interpreter.setQuiet(job.quiet);
+  interpreter.interpret(); // In this thread
+
+  BatchResult result;
+  result.displayLines = job.quiet ? interpreter.screenLines() : interpreter.takeDisplayLines();
+  for (int index = 0; index < 26 + context.memory().extraVarCount(); ++index)
+    result.variables << context.memory().variable(index);
+  result.error = interpreter.lastError();
+  result.errorStep = interpreter.errorStep();
+  result.lastResult = interpreter.lastResult();
+  result.executedSteps = interpreter.executedSteps();
+  return result;
+}
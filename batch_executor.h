@@ -0,0 +1,85 @@
+#ifndef BATCH_EXECUTOR_H
+#define BATCH_EXECUTOR_H
+
+#include <QMap>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include "misc.h"
+
+// A program to run against one input set, in a fresh memory
+class BatchJob
+{
+public:
+  BatchJob() : randomSeed(1), stepBudget(0), deadline(0), quiet(false) {}
+
+  QList<TextLine> program;
+  QList<TextLine> inputs;                   // Answers to the "?" prompts, in order
+  QMap<int, QList<TextLine> > programAreas; // Programs 0-9 callable with Prog, the others are empty
+  quint32 randomSeed;                       // Ran# seed
+  qint64 stepBudget;                        // Statements before Error_Break, 0 for no limit
+  qint64 deadline;                          // Milliseconds before Error_Break, 0 for no limit
+  bool quiet;                               // Only keep the last screen lines, see Interpreter::setQuiet()
+};
+
+class BatchResult
+{
+public:
+  BatchResult() : error(Error_No), errorStep(0), lastResult(0.0), executedSteps(0) {}
+
+  QList<TextLine> displayLines; // Everything the program displayed, error message included (last screen if quiet)
+  QVector<double> variables;    // A-Z then the Defm extra variables, at the end of the run
+  Error error;
+  int errorStep;
+  double lastResult;
+  qint64 executedSteps;
+};
+
+// Runs jobs on a pool of threads. Each worker takes its jobs from its own deque
+// and steals from the other ones once empty, so long programs don't leave threads idle.
+class BatchExecutor
+{
+public:
+  BatchExecutor(int threadCount = QThread::idealThreadCount());
+
+  int threadCount() const { return _threadCount; }
+
+  // Blocks until every job is done, results are in the jobs order
+  QVector<BatchResult> run(const QList<BatchJob> &jobs);
+
+  // Runs one job in the current thread
+  static BatchResult runJob(const BatchJob &job);
+
+private:
+  class JobDeque
+  {
+  public:
+    QMutex mutex;
+    QList<int> jobs; // Job indexes
+  };
+
+  class Worker : public QThread
+  {
+  public:
+    Worker(BatchExecutor *executor, int index) : _executor(executor), _index(index) {}
+
+    void run();
+
+  private:
+    BatchExecutor *_executor;
+    int _index;
+  };
+
+  int _threadCount;
+
+  // Run state
+  const QList<BatchJob> *_jobs;
+  BatchResult *_results;
+  QVector<JobDeque *> _deques;
+
+  // Pops from the back of the worker deque, or steals from the front of another one. Returns -1 if all are empty
+  int takeJob(int workerIndex);
+};
+
+#endif
@@ -3,7 +3,10 @@
 #include "calculator.h"
 
 Calculator::Calculator() :
-  _lcdDisplay(0)
+  _lcdDisplay(0),
+  _editedProgram(0),
+  _stoppedProgram(-1),
+  _stoppedOffset(0)
 {
   // Init run screen
   connect(&_runScreen, SIGNAL(changeChar(int, int, LCDChar)),
@@ -12,6 +15,8 @@ Calculator::Calculator() :
           this, SLOT(runScreenChanged()));
   connect(&_runScreen, SIGNAL(displayDefm()),
           this, SLOT(runScreenDisplayDefm()));
+  connect(&_runScreen, SIGNAL(stopped(int, int)),
+          this, SLOT(runScreenStopped(int, int)));
 
   // Init prog screen
   connect(&_progScreen, SIGNAL(changeChar(int, int, LCDChar)),
@@ -59,6 +64,15 @@ void Calculator::runScreenDisplayDefm()
   _lcdDisplay->drawScreen(getDefmScreen());
 }
 
+void Calculator::runScreenStopped(int program, int offset)
+{
+  _stoppedProgram = program;
+  _stoppedOffset = offset;
+  if (program >= 0 && program == _editedProgram && CalculatorState::instance().sysMode() == SysMode_WRT &&
+      CalculatorState::instance().screenMode() == ScreenMode_Editor)
+    _progEditScreen.showStep(offset);
+}
+
 QList<LCDString> Calculator::getResumeScreen() const
 {
   QList<LCDString> screen;
@@ -158,6 +172,24 @@ void Calculator::setBaseMode(BaseMode value)
   CalculatorState::instance().setBaseMode(value);
 }
 
+void Calculator::toggleBreakpoint()
+{
+  Interpreter &interpreter = _runScreen.interpreter();
+  if (CalculatorState::instance().sysMode() != SysMode_WRT ||
+      CalculatorState::instance().screenMode() != ScreenMode_Editor || interpreter.isBusy())
+    return;
+
+  int step = _progEditScreen.cursorStep();
+  interpreter.setBreakpoint(_editedProgram, step, !interpreter.hasBreakpoint(_editedProgram, step));
+}
+
+void Calculator::toggleSingleStep()
+{
+  Interpreter &interpreter = _runScreen.interpreter();
+  if (!interpreter.isBusy())
+    interpreter.setSingleStep(!interpreter.isSingleStep());
+}
+
 void Calculator::applyKey(int key)
 {
   switch (key)
@@ -165,6 +197,8 @@ void Calculator::applyKey(int key)
   case Qt::Key_F1: buttonClicked(Button_Shift); break;
   case Qt::Key_F2: buttonClicked(Button_Alpha); break;
   case Qt::Key_F3: buttonClicked(Button_Mode); break;
+  case Qt::Key_F9: toggleBreakpoint(); break;
+  case Qt::Key_F10: toggleSingleStep(); break;
   case Qt::Key_Left: buttonClicked(Button_Left); break;
   case Qt::Key_Right: buttonClicked(Button_Right); break;
   case Qt::Key_Up: buttonClicked(Button_Up); break;
@@ -246,8 +280,12 @@ void Calculator::editorChangeChar(int col, int line, LCDChar c)
 
 void Calculator::progEditProgram(int programIndex)
 {
+  _editedProgram = programIndex;
   _progEditScreen.setProgram(programIndex);
   CalculatorState::instance().setScreenMode(ScreenMode_Editor);
+  // Shows the statement of a stopped run
+  if (programIndex == _stoppedProgram && _runScreen.interpreter().waitForValidation())
+    _progEditScreen.showStep(_stoppedOffset);
 }
 
 void Calculator::progEditScreenChanged()
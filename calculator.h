@@ -33,9 +33,15 @@ private:
   ProgScreen _progScreen;
   ProgEditScreen _progEditScreen;
   LCDDisplay *_lcdDisplay;
+  int _editedProgram;
+  int _stoppedProgram; // Where the last run stopped, -1 if none
+  int _stoppedOffset;
 
   QList<LCDString> getResumeScreen() const;
   QList<LCDString> getDefmScreen() const;
+  // Debugging of the runs, only changed while no run is going on
+  void toggleBreakpoint(); // On the statement under the cursor of the program editor
+  void toggleSingleStep();
 
 private slots:
   void screenModeChanged(ScreenMode oldMode);
@@ -44,6 +50,7 @@ private slots:
   void runChangeChar(int col, int line, LCDChar c);
   void runScreenChanged();
   void runScreenDisplayDefm();
+  void runScreenStopped(int program, int offset);
 
   void progChangeChar(int col, int line, LCDChar c);
   void progEditProgram(int programIndex);
@@ -0,0 +1,94 @@
+#include <math.h>
+
+#include "emulator_context.h"
+#include "expression_solver.h"
+#include "memory.h"
+
+#include "check.h"
+
+int checkBatch()
+{
+  const char *expressions[] = {
+    "X{mul}2+1", "1/X", "{root}X", "{root}(X-Y)/(Y+1)", "{sin}X+{cos}Y{mul}{log}{abs}X", "A[X]", "A[Y]+X", "{-}X{square}",
+    "X{xy}Y", "(X+Y){mul}(X-Y)/{root}(X{square}+Y{square})", "{ln}X+{int}Y-{frac}X", "X!", "{-}X{mul}0", "A[1/X]",
+    "1/(1/X)", "{root}{root}X{mul}B+C", "{RanSharp}{mul}X+{RanSharp}", "1/X+{RanSharp}",
+    "A[{RanSharp}{mul}40-20]+{RanSharp}{mul}Y", "{root}(X-{RanSharp})/Y"
+  };
+
+  // Not a multiple of the block size nor of the SSE2 width. X gets 0.0, -0.0 and infinities, Y NaNs
+  const int count = 1003;
+  QVector<double> x(count), y(count);
+  quint32 state = 12345;
+  for (int lane = 0; lane < count; ++lane)
+  {
+    state = state * 1103515245 + 12345;
+    x[lane] = (int) ((state >> 16) % 4000) / 100.0 - 20.0;
+    state = state * 1103515245 + 12345;
+    y[lane] = (int) ((state >> 16) % 3000) / 100.0 - 10.0;
+    if (lane % 17 == 0)
+      x[lane] = 0.0;
+    if (lane % 19 == 0)
+      x[lane] = -0.0;
+    if (lane % 29 == 0)
+      x[lane] = lane % 2 ? INFINITY : -INFINITY;
+    if (lane % 23 == 0)
+      y[lane] = NAN;
+  }
+  QVector<int> variables;
+  variables << LCDChar_X - LCDChar_A << LCDChar_Y - LCDChar_A;
+  QVector<const double *> columns;
+  columns << x.constData() << y.constData();
+
+  EmulatorContext context;
+  Memory &memory = context.memory();
+  memory.setExtraVarCount(10);
+  for (int i = 0; i < 36; ++i)
+    memory.setVariable(i, i * 0.5 - 3.0);
+
+  int failures = 0;
+  ExpressionSolver solver(&context);
+  for (unsigned i = 0; i < sizeof(expressions) / sizeof(expressions[0]); ++i)
+  {
+    TextLine expression = TextLine(QString(expressions[i]));
+    CompiledExpression code = solver.compile(expression, 0);
+
+    QVector<double> values(36); // The batch must leave the memory alone
+    for (int index = 0; index < 36; ++index)
+      values[index] = memory.variable(index);
+    QVector<double> results(count);
+    QVector<ErrorStatus> errors(count);
+    context.setRandomSeed(7);
+    solver.evaluateBatch(code, variables, columns, count, results.data(), errors.data());
+    for (int index = 0; index < 36; ++index)
+      if (!isSameDouble(memory.variable(index), values[index]))
+      {
+        failureStream() << "Batch: " << charsToString(expression.charLine()) << " changes the variable "
+                        << index << '\n';
+        ++failures;
+      }
+
+    // Against evaluate(), lane after lane with the same Ran# draws
+    context.setRandomSeed(7);
+    for (int lane = 0; lane < count; ++lane)
+    {
+      memory.setVariable(variables[0], x[lane]);
+      memory.setVariable(variables[1], y[lane]);
+      double expected = 0.0;
+      ErrorStatus expectedStatus;
+      bool expectedOk = solver.evaluate(code, expected, expectedStatus);
+      bool ok = !errors[lane].isError();
+      if (ok == expectedOk &&
+          (ok ? isSameDouble(results[lane], expected) :
+                errors[lane].error() == expectedStatus.error() && errors[lane].offset() == expectedStatus.offset()))
+        continue;
+
+      failureStream() << "Batch: " << charsToString(expression.charLine()) << " lane " << lane << " gives "
+                      << outcome(ok, results[lane], errors[lane]) << " instead of "
+                      << outcome(expectedOk, expected, expectedStatus) << '\n';
+      ++failures;
+    }
+    memory.setVariable(variables[0], values[variables[0]]);
+    memory.setVariable(variables[1], values[variables[1]]);
+  }
+  return failures;
+}
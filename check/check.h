@@ -0,0 +1,36 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <QTextStream>
+
+#include "misc.h"
+
+// Checks of the emulator core. Each one prints its failures and returns their number
+
+// The compiled expressions give the same results and errors as if nothing was folded
+int checkFolding();
+// evaluateBatch() gives the same results and errors as evaluate() called for each lane, and leaves the memory alone
+int checkBatch();
+// The exit codes of the command line runner, and no crash on the way
+int checkCommandLine();
+// A cancel breaks the submitted programs, running or waiting, and only them
+int checkCancel();
+// Dsz and Isz loop the expected number of times and skip the right statement
+int checkStepCounters();
+// seek() gives the state of a run broken at the same step, back and forth
+int checkSeek();
+// A trace is saved, loaded and replayed unchanged, and corrupt or incomplete ones are refused
+int checkTrace();
+// The SPSC channel and queue keep the order of the items under contention
+int checkSpsc();
+// The batch executor gives the results of the jobs run one after the other
+int checkBatchExecutor();
+
+// Same bits, or both NaN
+bool isSameDouble(double d1, double d2);
+// Result or error, to print a failure
+QString outcome(bool ok, double result, const ErrorStatus &status);
+
+QTextStream &failureStream();
+
+#endif
@@ -0,0 +1,15 @@
+# Checks of the emulator core, built by check and by check_scalar, which each bring the core
+INCLUDEPATH += $$PWD $$PWD/.. $$PWD/../cli
+
+HEADERS += $$PWD/check.h \
+  $$PWD/../cli/command_line_runner.h
+
+SOURCES += $$PWD/main.cpp \
+  $$PWD/folding_check.cpp \
+  $$PWD/batch_check.cpp \
+  $$PWD/command_line_check.cpp \
+  $$PWD/interpreter_check.cpp \
+  $$PWD/trace_check.cpp \
+  $$PWD/spsc_check.cpp \
+  $$PWD/executor_check.cpp \
+  $$PWD/../cli/command_line_runner.cpp
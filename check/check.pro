@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = fx7500g-check
+CONFIG += console debug
+CONFIG -= app_bundle
+QT -= gui
+
+include(check.pri)
+LIBS += -L../core -lfx7500g-core
+PRE_TARGETDEPS += ../core/libfx7500g-core.a
+
+# make check runs it
+QMAKE_EXTRA_TARGETS += check
+check.commands = ./$(TARGET)
+check.depends = $(TARGET)
@@ -0,0 +1,47 @@
+#include <QCoreApplication>
+#include <QTimer>
+
+#include "command_line_runner.h"
+
+#include "check.h"
+
+// Runs the command line runner like fx7500g-cli <arguments>, returns its exit code
+static int runCommandLine(const QStringList &arguments)
+{
+  CommandLineRunner runner;
+  if (!runner.parseArguments(QStringList() << "fx7500g-cli" << arguments))
+    return CommandLineRunner::Exit_Usage;
+  QTimer::singleShot(0, &runner, SLOT(start()));
+  return QCoreApplication::exec();
+}
+
+int checkCommandLine()
+{
+  struct Case {
+    const char *arguments; // Separated by spaces
+    const char *program;   // Given with -e
+    int exitCode;
+  } cases[] = {
+    // The watched slot disappears: it reads as 0
+    { "-w A[30]", "{defm}10:5{->}A[30]:{defm}0:7", CommandLineRunner::Exit_Success },
+    { "-l 10", "{lbl}1:{goto}1", CommandLineRunner::Exit_Break },
+    { "", "1/0", CommandLineRunner::Exit_Error }
+  };
+
+  int failures = 0;
+  for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+  {
+    QStringList arguments;
+    if (*cases[i].arguments)
+      arguments = QString(cases[i].arguments).split(' ');
+    arguments << "-e" << cases[i].program;
+    int exitCode = runCommandLine(arguments);
+    if (exitCode == cases[i].exitCode)
+      continue;
+
+    failureStream() << "Command line: " << arguments.join(" ") << " exits with " << exitCode << " instead of "
+                    << cases[i].exitCode << '\n';
+    ++failures;
+  }
+  return failures;
+}
@@ -0,0 +1,79 @@
+#include "batch_executor.h"
+
+#include "check.h"
+
+static QString resultText(const BatchResult &result)
+{
+  QString text = QString("%1 steps, last %2").arg(result.executedSteps).arg(result.lastResult, 0, 'g', 17);
+  if (result.error != Error_No)
+    text += QString(", %1 at %2").arg(errorName(result.error)).arg(result.errorStep);
+  return text;
+}
+
+static bool isSameResult(const BatchResult &result1, const BatchResult &result2)
+{
+  if (result1.error != result2.error || result1.errorStep != result2.errorStep ||
+      !isSameDouble(result1.lastResult, result2.lastResult) || result1.executedSteps != result2.executedSteps ||
+      result1.displayLines != result2.displayLines || result1.variables.count() != result2.variables.count())
+    return false;
+  for (int i = 0; i < result1.variables.count(); ++i)
+    if (!isSameDouble(result1.variables[i], result2.variables[i]))
+      return false;
+  return true;
+}
+
+int checkBatchExecutor()
+{
+  QList<TextLine> input;
+  input << TextLine("\"X\"?{->}X:X{square}{triangle}X{mul}2");
+  QList<TextLine> random;
+  random << TextLine("20{->}N:0{->}S:{lbl}1:S+{RanSharp}{->}S:{dsz}N:{goto}1:S");
+  QList<TextLine> prog;
+  prog << TextLine("0{->}A:3{->}N:{lbl}1:{prog}2:{dsz}N:{goto}1:A");
+  QList<TextLine> error;
+  error << TextLine("1{->}A:1/0");
+  QList<TextLine> loop;
+  loop << TextLine("{lbl}1:{goto}1");
+  QList<TextLine> display; // More lines than the screen
+  display << TextLine("{defm}2:0{->}A:{lbl}1:A+1{->}A{triangle}A{->}A[27]:A<30{=>}{goto}1");
+
+  QList<BatchJob> jobs;
+  for (int i = 0; i < 48; ++i)
+  {
+    BatchJob job;
+    job.randomSeed = i + 1;
+    job.quiet = i % 4 == 0;
+    job.inputs << TextLine(QString::number(i));
+    switch (i % 6)
+    {
+    case 0: job.program = input; break;
+    case 1: job.program = random; break;
+    case 2:
+      job.program = prog;
+      job.programAreas[2] << TextLine("A+1{->}A");
+      break;
+    case 3: job.program = error; break;
+    case 4:
+      job.program = loop;
+      job.stepBudget = 1000 + i;
+      break;
+    default: job.program = display;
+    }
+    jobs << job;
+  }
+
+  // Against the jobs run one after the other
+  int failures = 0;
+  QVector<BatchResult> results = BatchExecutor(4).run(jobs);
+  for (int i = 0; i < jobs.count(); ++i)
+  {
+    BatchResult expected = BatchExecutor::runJob(jobs[i]);
+    if (isSameResult(results[i], expected))
+      continue;
+
+    failureStream() << "Batch executor: job " << i << " gives " << resultText(results[i]) << " instead of "
+                    << resultText(expected) << '\n';
+    ++failures;
+  }
+  return failures;
+}
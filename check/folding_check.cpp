@@ -0,0 +1,90 @@
+#include <math.h>
+
+#include "emulator_context.h"
+#include "expression_solver.h"
+#include "memory.h"
+
+#include "check.h"
+
+// The literals are single digits: the unfolded twin of an expression reads the digit <d> from the variable
+// K + <d> instead, at the same offset, so nothing can be folded and the error offsets are the same
+static TextLine unfolded(const TextLine &expression)
+{
+  TextLine result;
+  foreach (int entity, expression)
+    result << (isCipher(entity) ? LCDChar_K + entity - LCDChar_0 : entity);
+  return result;
+}
+
+static bool compileAndEvaluate(ExpressionSolver &solver, const TextLine &expression, double &result,
+                               ErrorStatus &status)
+{
+  try
+  {
+    CompiledExpression code = solver.compile(expression, 0);
+    return solver.evaluate(code, result, status);
+  }
+  catch (InterpreterException &exception)
+  {
+    status = ErrorStatus(exception.error(), exception.offset());
+    return false;
+  }
+}
+
+int checkFolding()
+{
+  // A to E hold the special values, %1 is replaced by each of them
+  const char *templates[] = {
+    "%1{mul}1", "1{mul}%1", "%1/1", "%1-0", "%1+0", "0+%1", "0-%1", "{-}%1{mul}1", "%1{mul}1{mul}1+0-0",
+    "1{mul}(%1+2){mul}1", "(1{mul}1){mul}%1", "%1{mul}(1{mul}(%1-0))/1", "%1/0", "%1{mul}0", "0/%1",
+    "{root}%1{mul}1", "%1{square}/1", "{sin}%1{mul}1", "A[%1{mul}0]", "1/%1-0"
+  };
+  const char *expressions[] = {
+    "2{mul}3+4{mul}5-6/7", "{root}2", "1/0", "5+{root}{-}1", "{root}{-}1+5", "{-}0", "{-}0{mul}1", "1{mul}{-}0",
+    "{-}0/1", "{-}0-0", "{-}0+0", "0-{-}0", "{-}(1{mul}{-}0)", "{sin}3", "{cos}3{mul}2", "3{degsuffix}", "{sin_1}(1/2)",
+    "{ln}0", "{log}{-}1", "1{mul}{ln}0", "0{minusoneup}", "2{xy}(1/2)", "3{xroot}8", "{cuberoot}8", "4!", "9{xy}9{xy}9",
+    "{-}9{xy}9{xy}9", "{int}(7/2)+{frac}(7/2)", "{abs}{-}3", "(1+2)(3+4)", "2(3{mul}1)", "1/(1-1)", "A[2{mul}1]",
+    "A[{-}1{mul}1]", "2{square}{square}{square}{square}{square}{square}{square}{square}{square}{square}"
+  };
+
+  QList<TextLine> cases;
+  for (unsigned i = 0; i < sizeof(templates) / sizeof(templates[0]); ++i)
+    for (char variable = 'A'; variable <= 'E'; ++variable)
+      cases << TextLine(QString(templates[i]).arg(QChar(variable)));
+  for (unsigned i = 0; i < sizeof(expressions) / sizeof(expressions[0]); ++i)
+    cases << TextLine(QString(expressions[i]));
+
+  EmulatorContext context;
+  Memory &memory = context.memory();
+  memory.setVariable(0, -0.0);
+  memory.setVariable(1, NAN);
+  memory.setVariable(2, INFINITY);
+  memory.setVariable(3, -INFINITY);
+  memory.setVariable(4, 3.0);
+  for (int digit = 0; digit < 10; ++digit)
+    memory.setVariable(LCDChar_K - LCDChar_A + digit, digit);
+
+  int failures = 0;
+  ExpressionSolver solver(&context);
+  for (int angleMode = Deg; angleMode <= Rad; ++angleMode)
+  {
+    context.setAngleMode((AngleMode) angleMode);
+    foreach (const TextLine &expression, cases)
+    {
+      double result = 0.0, expected = 0.0;
+      ErrorStatus status, expectedStatus;
+      bool ok = compileAndEvaluate(solver, expression, result, status);
+      bool expectedOk = compileAndEvaluate(solver, unfolded(expression), expected, expectedStatus);
+      if (ok == expectedOk &&
+          (ok ? isSameDouble(result, expected) :
+                status.error() == expectedStatus.error() && status.offset() == expectedStatus.offset()))
+        continue;
+
+      failureStream() << "Folding: " << charsToString(expression.charLine()) << " gives "
+                      << outcome(ok, result, status) << " instead of "
+                      << outcome(expectedOk, expected, expectedStatus) << '\n';
+      ++failures;
+    }
+  }
+  return failures;
+}
@@ -0,0 +1,162 @@
+#include <QThread>
+
+#include "interpreter.h"
+
+#include "check.h"
+
+static void waitForJobs(Interpreter &interpreter)
+{
+  while (interpreter.isBusy())
+    QThread::yieldCurrentThread();
+}
+
+static QString errorText(Error error)
+{
+  return error == Error_No ? QString("no error") : errorName(error);
+}
+
+static int checkLastError(Interpreter &interpreter, Error expected, const char *what)
+{
+  waitForJobs(interpreter);
+  if (interpreter.lastError() == expected)
+    return 0;
+
+  failureStream() << "Cancel: " << what << " ends with " << errorText(interpreter.lastError()) << " instead of "
+                  << errorText(expected) << '\n';
+  return 1;
+}
+
+int checkCancel()
+{
+  QList<TextLine> inlineProgram; // Run by submit() itself
+  inlineProgram << TextLine("1{->}A:A+1");
+  QList<TextLine> workerProgram;
+  workerProgram << TextLine("{lbl}1:1{->}A:A+1");
+  QList<TextLine> loop; // Only ended by a cancel
+  loop << TextLine("{lbl}1:{goto}1");
+
+  EmulatorContext context;
+  Interpreter interpreter(QList<TextLine>(), context);
+  interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+
+  int failures = 0;
+  interpreter.cancel();
+  interpreter.submit(inlineProgram);
+  failures += checkLastError(interpreter, Error_No, "a program submitted after a cancel");
+
+  // A cancel after the end of a run doesn't break the next program
+  interpreter.cancel();
+  interpreter.submit(inlineProgram);
+  failures += checkLastError(interpreter, Error_No, "an inline program submitted after the end of a cancelled one");
+  interpreter.submit(workerProgram);
+  waitForJobs(interpreter);
+  interpreter.cancel();
+  interpreter.submit(workerProgram);
+  failures += checkLastError(interpreter, Error_No, "a program submitted after the end of a cancelled one");
+
+  // The running program and the waiting one are broken
+  interpreter.submit(loop);
+  interpreter.submit(workerProgram);
+  interpreter.cancel();
+  failures += checkLastError(interpreter, Error_Break, "a program waiting for a cancelled loop");
+  interpreter.submit(workerProgram);
+  failures += checkLastError(interpreter, Error_No, "a program submitted after them");
+  return failures;
+}
+
+int checkStepCounters()
+{
+  struct Case {
+    const char *program;
+    double a; // A at the end
+  } cases[] = {
+    { "0{->}A:5{->}B:{lbl}1:A+1{->}A:{dsz}B:{goto}1", 5 },
+    { "0{->}A:{-}5{->}B:{lbl}1:A+1{->}A:{isz}B:{goto}1", 5 },
+    { "{defm}2:3{->}A[27]:0{->}A:{lbl}1:A+1{->}A:{dsz}A[27]:{goto}1", 3 },
+    { "0{->}A:1{->}B:{dsz}B:A+1{->}A:A+10{->}A", 10 }, // Skips the next statement at 0
+    { "0{->}A:2{->}B:{dsz}B:A+1{->}A:A+10{->}A", 11 },
+    { "0{->}A:1{->}B:{dsz}B{triangle}A+1{->}A:A+10{->}A", 10 }
+  };
+
+  int failures = 0;
+  for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+  {
+    EmulatorContext context;
+    Interpreter interpreter(QList<TextLine>() << TextLine(cases[i].program), context);
+    interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+    QueueInputProvider validations;
+    interpreter.setInputProvider(&validations);
+    interpreter.interpret();
+    double a = context.memory().variable(0);
+    if (!interpreter.error() && a == cases[i].a)
+      continue;
+
+    failureStream() << "Step counters: " << cases[i].program << " gives A = " << a << ", "
+                    << errorText(interpreter.lastError()) << " instead of A = " << cases[i].a << '\n';
+    ++failures;
+  }
+  return failures;
+}
+
+static QList<TextLine> seekedProgram()
+{
+  QList<TextLine> program;
+  program << TextLine("\"N\"?{->}N:0{->}B:{defm}2:{lbl}1:{RanSharp}{->}C:B+C{->}B:{prog}0:{isz}A[26]:{dsz}N:{goto}1:B");
+  return program;
+}
+
+static void setUpSeek(EmulatorContext &context)
+{
+  context.memory().programAt(0)->setSteps(QList<TextLine>() << TextLine("A[27]+B{->}A[27]:{rad}"));
+}
+
+// The variables, Ran# and angle mode of <context> are the ones of a run broken after <step> statements
+static bool isSeekedState(EmulatorContext &context, qint64 step)
+{
+  EmulatorContext reference(7);
+  setUpSeek(reference);
+  Interpreter interpreter(seekedProgram(), reference);
+  interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+  QueueInputProvider inputs(QList<TextLine>() << TextLine("30"));
+  interpreter.setInputProvider(&inputs);
+  interpreter.setStepBudget(step);
+  interpreter.interpret();
+
+  for (int i = 0; i < 28; ++i)
+    if (!isSameDouble(context.memory().variable(i), reference.memory().variable(i)))
+      return false;
+  return context.randomState() == reference.randomState() && context.angleMode() == reference.angleMode();
+}
+
+int checkSeek()
+{
+  // Few checkpoints, so the history is thinned during the run
+  EmulatorContext context(7);
+  setUpSeek(context);
+  ExecutionHistory history(8, 4);
+  Interpreter interpreter(seekedProgram(), context);
+  interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+  interpreter.setHistory(&history);
+  QueueInputProvider inputs(QList<TextLine>() << TextLine("30"));
+  interpreter.setInputProvider(&inputs);
+  interpreter.interpret();
+
+  int failures = 0;
+  qint64 end = history.end();
+  qint64 steps[] = { end, 1, end / 2, 7, 8, 9, end - 1, 2, end / 3 }; // Back and forth
+  for (unsigned i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i)
+  {
+    bool seeked = interpreter.seek(steps[i]);
+    if (seeked && interpreter.executedSteps() == steps[i] && isSeekedState(context, steps[i]))
+      continue;
+
+    failureStream() << "Seek: step " << steps[i] << " of " << end << (seeked ? " differs" : " fails") << '\n';
+    ++failures;
+  }
+  if (interpreter.seek(end + 1))
+  {
+    failureStream() << "Seek: the step after the end succeeds\n";
+    ++failures;
+  }
+  return failures;
+}
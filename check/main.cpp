@@ -0,0 +1,35 @@
+#include <string.h>
+
+#include <QCoreApplication>
+
+#include "check.h"
+
+bool isSameDouble(double d1, double d2)
+{
+  return !memcmp(&d1, &d2, sizeof(double)) || (d1 != d1 && d2 != d2);
+}
+
+QString outcome(bool ok, double result, const ErrorStatus &status)
+{
+  if (ok)
+    return QString::number(result, 'g', 17);
+  return QString("%1 at %2").arg(errorName(status.error())).arg(status.offset());
+}
+
+QTextStream &failureStream()
+{
+  static QTextStream stream(stderr);
+  return stream;
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv); // The command line runner needs an event loop
+
+  int failures = checkFolding() + checkBatch() + checkCommandLine() + checkCancel() + checkStepCounters() +
+                 checkSeek() + checkTrace() + checkSpsc() + checkBatchExecutor();
+
+  failureStream().flush();
+  QTextStream(stdout) << (failures ? QString("%1 failures").arg(failures) : QString("All checks passed")) << '\n';
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+#include <QThread>
+
+#include "spsc_channel.h"
+
+#include "check.h"
+
+static const int itemCount = 100000;
+
+// Pushes 0, 1, 2... as fast as the consumer lets it
+class ChannelProducer : public QThread
+{
+public:
+  ChannelProducer(SpscChannel<int, 8> *channel) : _channel(channel) {}
+
+protected:
+  void run()
+  {
+    for (int i = 0; i < itemCount; ++i)
+      while (!_channel->tryPush(i))
+        QThread::yieldCurrentThread(); // Full
+  }
+
+private:
+  SpscChannel<int, 8> *_channel;
+};
+
+class QueueProducer : public QThread
+{
+public:
+  QueueProducer(SpscQueue<int> *queue) : _queue(queue) {}
+
+protected:
+  void run()
+  {
+    for (int i = 0; i < itemCount; ++i)
+      _queue->push(i);
+  }
+
+private:
+  SpscQueue<int> *_queue;
+};
+
+static int checkChannel(int spinCount, const char *what)
+{
+  SpscChannel<int, 8> channel; // Small, so the producer keeps finding it full
+  ChannelProducer producer(&channel);
+  producer.start();
+
+  int failures = 0;
+  for (int i = 0; i < itemCount; ++i)
+  {
+    int value = -1;
+    if (!channel.pop(value, spinCount) || value != i)
+    {
+      failureStream() << "SPSC: the channel " << what << " gives " << value << " instead of " << i << '\n';
+      ++failures;
+      break;
+    }
+  }
+  producer.wait();
+
+  int value;
+  if (!failures && channel.tryPop(value))
+  {
+    failureStream() << "SPSC: the channel " << what << " gives " << value << " after the last item\n";
+    ++failures;
+  }
+  return failures;
+}
+
+int checkSpsc()
+{
+  // Spinning, then sleeping on each pop so that every push has to wake the consumer
+  int failures = checkChannel(-1, "spinning") + checkChannel(0, "sleeping");
+
+  SpscQueue<int> queue;
+  QueueProducer producer(&queue);
+  producer.start();
+  for (int i = 0; i < itemCount; ++i)
+  {
+    int value;
+    while (!queue.tryPop(value))
+      QThread::yieldCurrentThread(); // Empty
+    if (value != i)
+    {
+      failureStream() << "SPSC: the queue gives " << value << " instead of " << i << '\n';
+      ++failures;
+      break;
+    }
+  }
+  producer.wait();
+  return failures;
+}
@@ -0,0 +1,102 @@
+#include <QBuffer>
+
+#include "execution_trace.h"
+#include "input_provider.h"
+#include "interpreter.h"
+#include "memory.h"
+
+#include "check.h"
+
+static QList<TextLine> tracedProgram()
+{
+  QList<TextLine> program;
+  program << TextLine("\"N\"?{->}N:0{->}B:{lbl}1:{RanSharp}{->}C:B+C{->}B:{prog}0:{dsz}N:{goto}1:B");
+  return program;
+}
+
+// Records or replays <trace> with the context of the recorded run
+static int runTraced(ExecutionTrace &trace, bool replay, const QString &prog0 = "A+B{->}A")
+{
+  EmulatorContext context(7);
+  context.memory().programAt(0)->setSteps(QList<TextLine>() << TextLine(prog0));
+  Interpreter interpreter(tracedProgram(), context);
+  interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+  if (replay)
+    return trace.replay(interpreter);
+
+  QueueInputProvider inputs(QList<TextLine>() << TextLine("5"));
+  interpreter.setInputProvider(&inputs);
+  interpreter.setTrace(&trace);
+  interpreter.interpret();
+  return -1;
+}
+
+static bool loadTrace(ExecutionTrace &trace, QByteArray data)
+{
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  return trace.load(&buffer);
+}
+
+int checkTrace()
+{
+  int failures = 0;
+  ExecutionTrace trace;
+  runTraced(trace, false);
+
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+  ExecutionTrace loaded;
+  if (!trace.save(&buffer) || !loadTrace(loaded, buffer.data()))
+  {
+    failureStream() << "Trace: a saved trace can't be loaded\n";
+    return 1;
+  }
+  if (loaded.events() != trace.events() || !loaded.isComplete())
+  {
+    failureStream() << "Trace: the loaded events differ from the saved ones\n";
+    ++failures;
+  }
+
+  int index = runTraced(loaded, true);
+  if (index != -1)
+  {
+    failureStream() << "Trace: the replay of the same run differs at event " << index << '\n';
+    ++failures;
+  }
+  index = runTraced(loaded, true, "A+B+1{->}A");
+  if (index < 0)
+  {
+    failureStream() << "Trace: the replay of a changed program gives " << index << " instead of a difference\n";
+    ++failures;
+  }
+
+  // The start of a long run is dropped by a small trace
+  ExecutionTrace small(0);
+  EmulatorContext context;
+  Interpreter interpreter(QList<TextLine>() << TextLine("0{->}A:{lbl}1:A+1{->}A:A<5000{=>}{goto}1"), context);
+  interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+  interpreter.setTrace(&small);
+  interpreter.interpret();
+  index = small.replay(interpreter);
+  if (small.isComplete() || index != ExecutionTrace::incompleteTrace)
+  {
+    failureStream() << "Trace: the replay of an incomplete trace gives " << index << '\n';
+    ++failures;
+  }
+
+  // A corrupt input count, much more than the bytes left, and a truncated trace
+  QByteArray corrupt = buffer.data().left(10);
+  const char input[] = { (char) 0x84, (char) 0x80, (char) 0x80, (char) 0x80, (char) 0x08 }; // 2^28 entities
+  corrupt[6] = sizeof(input);
+  corrupt[7] = corrupt[8] = corrupt[9] = 0;
+  for (unsigned i = 0; i < sizeof(input); ++i)
+    corrupt.append(input[i]);
+  ExecutionTrace rejected;
+  if (loadTrace(rejected, corrupt) || loadTrace(rejected, buffer.data().left(buffer.data().count() - 1)))
+  {
+    failureStream() << "Trace: a corrupt trace is loaded\n";
+    ++failures;
+  }
+  return failures;
+}
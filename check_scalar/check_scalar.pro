@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = fx7500g-check-scalar
+CONFIG += console debug
+CONFIG -= app_bundle
+QT -= gui
+
+# The same checks with the whole core built again without the SSE2 code of the expression solver,
+# instead of the library: mixing both builds of a file would break the one definition rule
+include(../core.pri)
+include(../check/check.pri)
+QMAKE_CXXFLAGS += -U__SSE2__
+
+# make check runs it
+QMAKE_EXTRA_TARGETS += check
+check.commands = ./$(TARGET)
+check.depends = $(TARGET)
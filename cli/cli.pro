@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = fx7500g-cli
+CONFIG += console debug
+CONFIG -= app_bundle
+QT -= gui
+
+INCLUDEPATH += ..
+LIBS += -L../core -lfx7500g-core
+PRE_TARGETDEPS += ../core/libfx7500g-core.a
+
+HEADERS += command_line_runner.h
+
+SOURCES += main.cpp \
+  command_line_runner.cpp
@@ -0,0 +1,370 @@
+#include <stdio.h>
+
+#include <QCoreApplication>
+#include <QFile>
+
+#include "memory.h"
+#include "program_parser.h"
+
+#include "command_line_runner.h"
+
+CommandLineRunner::CommandLineRunner(QObject *parent) :
+  QObject(parent),
+  _interpreter(QList<TextLine>(), _context),
+  _replay(false),
+  _check(false),
+  _inputsFromStdin(true),
+  _missingInput(false),
+  _out(stdout),
+  _in(stdin)
+{
+  // The interpreter thread waits while the slots are running, so they must be queued
+  connect(&_interpreter, SIGNAL(displayLine()), this, SLOT(interpreterDisplayLine()), Qt::QueuedConnection);
+  connect(&_interpreter, SIGNAL(askForInput()), this, SLOT(interpreterAskForInput()), Qt::QueuedConnection);
+  connect(&_interpreter, SIGNAL(askForValidation()), this, SLOT(interpreterAskForValidation()), Qt::QueuedConnection);
+  connect(&_interpreter, SIGNAL(jobFinished()), this, SLOT(interpreterFinished()), Qt::QueuedConnection);
+  connect(&_interpreter, SIGNAL(stopped()), this, SLOT(interpreterStopped()), Qt::QueuedConnection);
+
+  _interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+}
+
+QString CommandLineRunner::usage()
+{
+  return QString("Usage: fx7500g-cli [options] <file>\n"
+                 "       fx7500g-cli [options] -e <program>\n"
+                 "Programs are written one line per line, special entities as {id} (e.g. {goto}, {->})\n"
+                 "Options:\n"
+                 "  -e <program>       Run <program> instead of a file\n"
+                 "  -p <n> <file>      Load <file> into the program area <n> (0-9)\n"
+                 "  -i <value>         Queue an input for \"?\", stdin is used if none is given\n"
+                 "  -s none|real|virtual  Speed mode (default: none)\n"
+                 "  -l <steps>         Break the program after <steps> statements\n"
+                 "  -t <msecs>         Break the program after <msecs> milliseconds\n"
+                 "  -P                 Print a profile of the run to stderr\n"
+                 "  -T <file>          Record a trace of the run into <file>\n"
+                 "  -R <file>          Run again the trace <file> with its recorded inputs and report\n"
+                 "                     the first difference\n"
+                 "  -b [<n>:]<offset>  Stop before the statement at the raw steps <offset> of the program\n"
+                 "                     area <n>, of the main program if not given\n"
+                 "  -w <variable>      Stop when <variable> (A-Z or A[<n>]) changes\n"
+                 "  -S                 Stop before each statement\n"
+                 "  -c                 Check the programs and report all their errors without running\n"
+                 "Stops print the location to stderr and go on\n");
+}
+
+bool CommandLineRunner::parseArguments(const QStringList &arguments)
+{
+  QTextStream err(stderr);
+  bool programFound = false;
+  for (int i = 1; i < arguments.count(); ++i)
+  {
+    const QString &argument = arguments[i];
+    int remaining = arguments.count() - i - 1;
+    if (argument == "-e" && remaining >= 1)
+    {
+      _program.clear();
+      foreach (const QString &line, arguments[++i].split('\n'))
+        _program << TextLine(line);
+      programFound = true;
+    } else if (argument == "-p" && remaining >= 2)
+    {
+      if (!loadProgram(arguments[i + 1], arguments[i + 2]))
+        return false;
+      i += 2;
+    } else if (argument == "-i" && remaining >= 1)
+    {
+      _inputs.enqueue(arguments[++i]);
+      _inputsFromStdin = false;
+    } else if ((argument == "-l" || argument == "-t") && remaining >= 1)
+    {
+      bool ok;
+      qint64 value = arguments[++i].toLongLong(&ok);
+      if (!ok || value < 0)
+      {
+        err << "Bad limit: " << arguments[i] << '\n';
+        return false;
+      }
+      if (argument == "-l")
+        _interpreter.setStepBudget(value);
+      else
+        _interpreter.setDeadline(value);
+    } else if (argument == "-P")
+    {
+      _interpreter.setProfiler(&_profiler);
+    } else if (argument == "-T" && remaining >= 1)
+    {
+      _traceFileName = arguments[++i];
+      _interpreter.setTrace(&_trace);
+    } else if (argument == "-R" && remaining >= 1)
+    {
+      if (!loadTrace(arguments[++i]))
+        return false;
+      _replay = true;
+    } else if (argument == "-b" && remaining >= 1)
+    {
+      if (!parseBreakpoint(arguments[++i]))
+        return false;
+    } else if (argument == "-w" && remaining >= 1)
+    {
+      if (!parseWatchpoint(arguments[++i]))
+        return false;
+    } else if (argument == "-S")
+    {
+      _interpreter.setSingleStep(true);
+    } else if (argument == "-c")
+    {
+      _check = true;
+    } else if (argument == "-s" && remaining >= 1)
+    {
+      QString mode = arguments[++i];
+      if (mode == "none")
+        _interpreter.setSpeedMode(SpeedGovernor::Mode_Unthrottled);
+      else if (mode == "real")
+        _interpreter.setSpeedMode(SpeedGovernor::Mode_RealHardware);
+      else if (mode == "virtual")
+        _interpreter.setSpeedMode(SpeedGovernor::Mode_VirtualClock);
+      else
+      {
+        err << "Unknown speed mode: " << mode << '\n';
+        return false;
+      }
+    } else if (!argument.startsWith('-') && !programFound)
+    {
+      if (!readProgramFile(argument, _program))
+        return false;
+      programFound = true;
+    } else
+    {
+      err << usage();
+      return false;
+    }
+  }
+
+  if (!programFound)
+  {
+    err << usage();
+    return false;
+  }
+  return true;
+}
+
+bool CommandLineRunner::readProgramFile(const QString &fileName, QList<TextLine> &lines)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+  {
+    QTextStream(stderr) << "Can't read " << fileName << '\n';
+    return false;
+  }
+
+  lines.clear();
+  QTextStream stream(&file);
+  while (!stream.atEnd())
+    lines << TextLine(stream.readLine());
+  return true;
+}
+
+bool CommandLineRunner::loadProgram(const QString &index, const QString &fileName)
+{
+  bool ok;
+  int programIndex = index.toInt(&ok);
+  if (!ok || programIndex < 0 || programIndex >= Memory::programsCount)
+  {
+    QTextStream(stderr) << "Bad program area: " << index << '\n';
+    return false;
+  }
+
+  QList<TextLine> lines;
+  if (!readProgramFile(fileName, lines))
+    return false;
+  _context.memory().programAt(programIndex)->setSteps(lines);
+  return true;
+}
+
+bool CommandLineRunner::parseBreakpoint(const QString &argument)
+{
+  QStringList parts = argument.split(':');
+  bool programOk = true;
+  bool offsetOk;
+  int program = parts.count() == 2 ? parts[0].toInt(&programOk) : -1;
+  int offset = parts.last().toInt(&offsetOk);
+  if (parts.count() > 2 || !programOk || !offsetOk || program < -1 || program >= Memory::programsCount || offset < 0)
+  {
+    QTextStream(stderr) << "Bad breakpoint: " << argument << '\n';
+    return false;
+  }
+  _breakpoints << qMakePair(program, offset);
+  return true;
+}
+
+bool CommandLineRunner::parseWatchpoint(const QString &argument)
+{
+  const QString name = argument.toUpper();
+  int variable = -1;
+  if (name.count() == 1 && name[0] >= 'A' && name[0] <= 'Z')
+    variable = name[0].unicode() - 'A';
+  else if (name.startsWith("A[") && name.endsWith(']'))
+  {
+    bool ok;
+    variable = name.mid(2, name.count() - 3).toInt(&ok);
+    if (!ok || variable >= Memory::variablesCount)
+      variable = -1;
+  }
+  if (variable < 0)
+  {
+    QTextStream(stderr) << "Bad variable: " << argument << '\n';
+    return false;
+  }
+  _interpreter.setWatchpoint(variable);
+  return true;
+}
+
+bool CommandLineRunner::loadTrace(const QString &fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly) || !_trace.load(&file))
+  {
+    QTextStream(stderr) << "Can't read the trace " << fileName << '\n';
+    return false;
+  }
+  if (!_trace.isComplete())
+  {
+    QTextStream(stderr) << "The trace " << fileName << " doesn't hold the whole run" << '\n';
+    return false;
+  }
+  return true;
+}
+
+void CommandLineRunner::saveTrace()
+{
+  QFile file(_traceFileName);
+  if (!file.open(QIODevice::WriteOnly) || !_trace.save(&file))
+    QTextStream(stderr) << "Can't write the trace " << _traceFileName << '\n';
+  else if (!_trace.isComplete())
+    QTextStream(stderr) << "The run was too long, the trace only holds its end" << '\n';
+}
+
+void CommandLineRunner::start()
+{
+  if (_check)
+  {
+    int errors = check(_program, "Main program");
+    for (int i = 0; i < Memory::programsCount; ++i)
+      errors += check(_context.memory().programAt(i)->steps(), QString("Prog %1").arg(i));
+    QCoreApplication::exit(errors ? Exit_Error : Exit_Success);
+    return;
+  }
+
+  // The offsets are taken to the start of their statement, so the programs must be compiled
+  _interpreter.setProgram(_program);
+  for (int i = 0; i < _breakpoints.count(); ++i)
+    _interpreter.setBreakpoint(_breakpoints[i].first, _breakpoints[i].second);
+
+  if (_replay)
+    replay();
+  else
+    _interpreter.submit(_program);
+}
+
+int CommandLineRunner::check(const QList<TextLine> &program, const QString &name)
+{
+  ProgramParser parser(program);
+  foreach (const ProgramParser::Diagnostic &diagnostic, parser.diagnostics())
+    _out << name << ", line " << diagnostic.line + 1 << ", offset " << diagnostic.offset << " (step "
+         << diagnostic.step << "): " << errorName(diagnostic.error) << '\n';
+  _out.flush();
+  return parser.diagnostics().count();
+}
+
+void CommandLineRunner::replay()
+{
+  _interpreter.setProgram(_program);
+  ExecutionTrace::Event expected;
+  ExecutionTrace::Event actual;
+  int index = _trace.replay(_interpreter, &expected, &actual);
+  if (index == ExecutionTrace::incompleteTrace) // Rejected by loadTrace() already
+    QCoreApplication::exit(Exit_Usage);
+  else if (index < 0)
+  {
+    _out << "Same run" << '\n';
+    _out.flush();
+    QCoreApplication::exit(Exit_Success);
+  } else
+  {
+    _out << "Event " << index << ": expected " << expected.toString() << ", got " << actual.toString() << '\n';
+    _out.flush();
+    QCoreApplication::exit(Exit_Diverged);
+  }
+}
+
+void CommandLineRunner::printLine(const TextLine &textLine)
+{
+  QString line = charsToString(textLine.charLine());
+  if (textLine.rightJustified())
+    line = line.rightJustified(16);
+  _out << line << '\n';
+  _out.flush(); // Before the next stderr message
+}
+
+void CommandLineRunner::interpreterDisplayLine()
+{
+  foreach (const TextLine &textLine, _interpreter.takeDisplayLines())
+    printLine(textLine);
+}
+
+void CommandLineRunner::interpreterAskForInput()
+{
+  QString value;
+  if (!_inputs.isEmpty())
+    value = _inputs.dequeue();
+  else if (_inputsFromStdin && !_in.atEnd())
+    value = _in.readLine();
+  else
+    _missingInput = true; // The empty input ends the program with a syntax error
+
+  _out << value << '\n';
+  _out.flush();
+  _interpreter.sendInput(TextLine(value));
+}
+
+void CommandLineRunner::interpreterAskForValidation()
+{
+  TextLine textLine("- Disp -");
+  textLine.setRightJustified(true);
+  printLine(textLine);
+  _interpreter.sendValidation();
+}
+
+void CommandLineRunner::interpreterFinished()
+{
+  if (_interpreter.profiler())
+    QTextStream(stderr) << _profiler.report(_program, _context.memory());
+  if (_interpreter.trace())
+    saveTrace();
+
+  if (_missingInput)
+    QCoreApplication::exit(Exit_MissingInput);
+  else if (_interpreter.lastError() == Error_Break)
+    QCoreApplication::exit(Exit_Break);
+  else if (_interpreter.error())
+    QCoreApplication::exit(Exit_Error);
+  else
+    QCoreApplication::exit(Exit_Success);
+}
+
+void CommandLineRunner::interpreterStopped()
+{
+  QTextStream err(stderr);
+  int program = _interpreter.currentProgram();
+  err << "Stopped at " << (program < 0 ? QString("main program") : QString("Prog %1").arg(program))
+      << " step " << _interpreter.currentOffset();
+  if (_interpreter.stopReason() == Interpreter::Stop_Watchpoint)
+  {
+    int variable = _interpreter.stopVariable();
+    err << ", " << (variable < 26 ? QString(QChar('A' + variable)) : QString("A[%1]").arg(variable))
+        << " = " << QString::number(_context.memory().variable(variable), 'g', 10);
+  }
+  err << '\n';
+  err.flush();
+  _interpreter.sendValidation();
+}
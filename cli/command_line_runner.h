@@ -0,0 +1,71 @@
+#ifndef COMMAND_LINE_RUNNER_H
+#define COMMAND_LINE_RUNNER_H
+
+#include <QObject>
+#include <QPair>
+#include <QQueue>
+#include <QStringList>
+#include <QTextStream>
+
+#include "interpreter.h"
+
+// Runs a program without any window: display lines are printed to stdout,
+// "?" inputs are taken from the command line or from stdin, pauses and stops are validated automatically
+class CommandLineRunner : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum ExitCode {
+    Exit_Success = 0,
+    Exit_Error = 1,         // The program ended with a calculator error, or -c found errors
+    Exit_Usage = 2,         // Bad arguments or unreadable file
+    Exit_MissingInput = 3,  // No more input for a "?"
+    Exit_Break = 4,         // Step budget or deadline reached
+    Exit_Diverged = 5       // The replayed run differs from the trace
+  };
+
+  CommandLineRunner(QObject *parent = 0);
+
+  // Returns false (and prints why) if the arguments are not valid
+  bool parseArguments(const QStringList &arguments);
+  static QString usage();
+
+public slots:
+  void start(); // Quits the application at the end of the program
+
+private slots:
+  void interpreterDisplayLine();
+  void interpreterAskForInput();
+  void interpreterAskForValidation();
+  void interpreterFinished();
+  void interpreterStopped();
+
+private:
+  EmulatorContext _context; // The runner doesn't share the calculator window memory
+  Interpreter _interpreter;
+  QList<TextLine> _program;
+  QQueue<QString> _inputs;
+  ExecutionProfiler _profiler; // Used with -P
+  ExecutionTrace _trace; // Recorded with -T, replayed with -R
+  QString _traceFileName; // -T
+  QList<QPair<int, int> > _breakpoints; // -b program and offset, set once the programs are loaded
+  bool _replay;
+  bool _check; // -c
+  bool _inputsFromStdin;
+  bool _missingInput;
+  QTextStream _out;
+  QTextStream _in;
+
+  bool readProgramFile(const QString &fileName, QList<TextLine> &lines);
+  bool loadProgram(const QString &index, const QString &fileName);
+  bool parseBreakpoint(const QString &argument);
+  bool parseWatchpoint(const QString &argument);
+  bool loadTrace(const QString &fileName);
+  void saveTrace();
+  void replay();
+  int check(const QList<TextLine> &program, const QString &name); // Returns the errors count
+  void printLine(const TextLine &textLine);
+};
+
+#endif
@@ -0,0 +1,17 @@
+#include <QCoreApplication>
+#include <QTimer>
+
+#include "command_line_runner.h"
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  CommandLineRunner runner;
+  if (!runner.parseArguments(app.arguments()))
+    return CommandLineRunner::Exit_Usage;
+
+  QTimer::singleShot(0, &runner, SLOT(start()));
+
+  return app.exec();
+}
@@ -0,0 +1,45 @@
+#ifndef COMPILED_EXPRESSION_H
+#define COMPILED_EXPRESSION_H
+
+#include <QVector>
+
+// Postfix form of an expression, produced by ExpressionSolver::compile().
+// Operations on numbers only are already computed, and identities like x*1 are removed
+class CompiledExpression
+{
+public:
+  enum ItemType {
+    Item_Number,        // Push <value>
+    Item_Variable,      // Push the variable <entity>
+    Item_Random,        // Push Ran#
+    Item_ArrayVariable, // Pop the index and push the variable <entity>[index]
+    Item_Operation      // Perform the operation <entity>
+  };
+
+  class Item
+  {
+  public:
+    Item(ItemType t = Item_Number, int e = 0, int o = 0, double v = 0.0) : type(t), entity(e), offset(o), value(v) {}
+
+    ItemType type;
+    int entity;
+    int offset; // Offset reported by the errors of this item
+    double value;
+  };
+
+  CompiledExpression() : _endOffset(0) {}
+
+  const QVector<Item> &items() const { return _items; }
+  void append(const Item &item) { _items << item; }
+  void remove(int index, int count) { _items.remove(index, count); }
+
+  // Offset following the expression in its program
+  int endOffset() const { return _endOffset; }
+  void setEndOffset(int value) { _endOffset = value; }
+
+private:
+  QVector<Item> _items;
+  int _endOffset;
+};
+
+#endif
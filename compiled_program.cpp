@@ -0,0 +1,346 @@
+#include <math.h>
+
+#include "compiled_program.h"
+
+void CompiledProgram::clear()
+{
+  _instructions.clear();
+  _strings.clear();
+  _expressions.clear();
+  for (int i = 0; i < 10; ++i)
+    _labels[i] = -1;
+  _instructions << Instruction(Op_End);
+}
+
+void CompiledProgram::compile(const TextLine &rawSteps)
+{
+  clear();
+  _instructions.clear(); // Remove the Op_End of the empty program
+  _rawSteps = &rawSteps;
+  _offset = 0;
+  _pendingCounter = -1;
+
+  QList<int> conditions; // Conditions waiting for the end of their statement
+  QList<int> counters; // Dsz/Isz waiting for the end of the next statement
+  while (currentEntity() != -1)
+  {
+    try
+    {
+      if (compileStatement())
+      {
+        conditions << _instructions.count() - 1;
+        continue;
+      }
+    } catch (InterpreterException exception)
+    {
+      Instruction instruction(Op_Error, -1, exception.offset());
+      instruction.operand = exception.error();
+      append(instruction);
+      moveOffsetToNextSeparator();
+      continue;
+    }
+
+    // Separator is mandatory
+    if (atStatementEnd())
+    {
+      // False conditions continue on the separator
+      foreach (int index, conditions)
+        _instructions[index].jump = _instructions.count();
+      conditions.clear();
+
+      // Dsz/Isz skip the statement following theirs
+      foreach (int index, counters)
+        _instructions[index].jump = _instructions.count();
+      counters.clear();
+      if (_pendingCounter >= 0)
+        counters << _pendingCounter;
+      _pendingCounter = -1;
+
+      int offset = _offset;
+      if (readEntity() == LCDChar_RBTriangle)
+        append(Instruction(Op_Pause, LCDChar_RBTriangle, offset));
+    } else
+    {
+      Instruction instruction(Op_Error, -1, _offset);
+      instruction.operand = Error_Syntax;
+      append(instruction);
+      moveOffsetToNextSeparator();
+    }
+  }
+
+  foreach (int index, conditions + counters)
+    _instructions[index].jump = _instructions.count();
+  append(Instruction(Op_End, -1, _offset));
+
+  // Resolve the gotos with the label table
+  for (int i = 0; i < _instructions.count(); ++i)
+  {
+    Instruction &instruction = _instructions[i];
+    if (instruction.op != Op_Goto)
+      continue;
+    instruction.jump = labelInstruction(instruction.operand);
+    if (instruction.jump < 0)
+    {
+      instruction.op = Op_Error;
+      instruction.operand = Error_Goto;
+    }
+  }
+
+  _rawSteps = 0;
+}
+
+bool CompiledProgram::compileStatement() throw (InterpreterException)
+{
+  int entity = currentEntity();
+  switch (entity)
+  {
+  case LCDChar_DoubleQuote: compileString(); break;
+  case LCDChar_Question: compileInput(QList<TextLine>() << TextLine(), entity, _offset); break;
+  case LCDOp_Lbl: compileLabel(); break;
+  case LCDOp_Goto: compileGoto(); break;
+  case LCDOp_Deg: case LCDOp_Rad: case LCDOp_Gra:
+    {
+      Instruction instruction(Op_AngleMode, entity, _offset);
+      instruction.operand = readEntity();
+      append(instruction);
+    }
+    break;
+  case LCDOp_Prog: compileProg(); break;
+  case LCDOp_Defm: compileDefm(); break;
+  case LCDOp_Dsz: case LCDOp_Isz: compileCounter(); break;
+  default:
+    if (ExpressionSolver::isExpressionStartEntity(entity))
+      return compileExpression();
+    else if (isSeparator(entity))
+      append(Instruction(Op_Nop, entity, _offset));
+    else
+      throw InterpreterException(Error_Syntax, _offset);
+  }
+  return false;
+}
+
+void CompiledProgram::compileString() throw (InterpreterException)
+{
+  int offset = _offset;
+  QList<TextLine> lines;
+  TextLine textLine;
+  int entity;
+  readEntity(); // Pass the "
+  while ((entity = currentEntity()) != -1)
+  {
+    if (eatEntity(LCDChar_DoubleQuote))
+      break;
+    else if (entity == LCDChar_CR || entity == LCDChar_RBTriangle)
+    {
+      lines << textLine;
+      textLine.clear();
+    } else
+      textLine << entity;
+    readEntity(); // Pass the current entity
+  }
+
+  if (entity == -1)
+  {
+    // The complete lines are displayed before the error
+    if (lines.count())
+    {
+      Instruction instruction(Op_Display, LCDChar_DoubleQuote, offset);
+      instruction.operand = appendStrings(lines);
+      append(instruction);
+    }
+    throw InterpreterException(Error_Syntax, offset); // At the opening quote
+  }
+
+  lines << textLine;
+  if (currentEntity() == LCDChar_Question)
+    compileInput(lines, LCDChar_DoubleQuote, offset);
+  else
+  {
+    Instruction instruction(Op_Display, LCDChar_DoubleQuote, offset);
+    instruction.operand = appendStrings(lines);
+    append(instruction);
+  }
+}
+
+void CompiledProgram::compileInput(QList<TextLine> lines, int entity, int offset) throw (InterpreterException)
+{
+  readEntity(); // Pass the "?"
+  lines.last() << LCDChar_Question;
+
+  Instruction instruction(Op_Input, entity, offset);
+  try
+  {
+    if (!eatEntity(LCDChar_Arrow)) // Pass the "->"
+      throw InterpreterException(Error_Syntax, _offset);
+    readDestination(instruction);
+  } catch (InterpreterException exception)
+  {
+    // The prompt is displayed before the error
+    Instruction display(Op_Display, entity, offset);
+    display.operand = appendStrings(lines);
+    append(display);
+    throw;
+  }
+  instruction.operand = appendStrings(lines);
+  append(instruction);
+}
+
+bool CompiledProgram::compileExpression() throw (InterpreterException)
+{
+  Instruction instruction(Op_Expression, currentEntity(), _offset);
+  instruction.expression = compileExpressionAt();
+
+  if (eatEntity(LCDChar_Arrow)) // Affectation?
+    readDestination(instruction);
+  else if (isComparisonOperator(currentEntity()))
+  {
+    instruction.op = Op_Condition;
+    instruction.comparison = readEntity();
+    instruction.expression2 = compileExpressionAt();
+
+    // "=>" is expected
+    if (!eatEntity(LCDChar_DoubleArrow))
+      throw InterpreterException(Error_Syntax, _offset);
+
+    // Some non sep char is expected
+    if (atStatementEnd())
+      throw InterpreterException(Error_Syntax, _offset);
+
+    append(instruction);
+    return true;
+  }
+  append(instruction);
+  return false;
+}
+
+void CompiledProgram::compileLabel() throw (InterpreterException)
+{
+  int offset = _offset;
+  int cipher = readCipherArgument();
+
+  // Only labels beginning a line or following a separator can be reached
+  if (_labels[cipher] < 0 && (offset == 0 || isSeparator((*_rawSteps)[offset - 1])))
+    _labels[cipher] = _instructions.count();
+}
+
+void CompiledProgram::compileGoto() throw (InterpreterException)
+{
+  Instruction instruction(Op_Goto, LCDOp_Goto, _offset);
+  instruction.operand = readCipherArgument();
+  instruction.errorOffset = _offset;
+  append(instruction); // Resolved at the end of the compilation
+}
+
+void CompiledProgram::compileProg() throw (InterpreterException)
+{
+  Instruction instruction(Op_Prog, LCDOp_Prog, _offset);
+  instruction.operand = readCipherArgument();
+  append(instruction);
+}
+
+void CompiledProgram::compileDefm() throw (InterpreterException)
+{
+  Instruction instruction(Op_Defm, LCDOp_Defm, _offset);
+  readEntity(); // Pass the "defm"
+
+  if (isCipher(currentEntity()) || currentEntity() == LCDChar_Dot)
+    instruction.operand = (int) roundf(ExpressionSolver::parseNumber(*_rawSteps, _offset));
+  else if (!atStatementEnd())
+    throw InterpreterException(Error_Argument, _offset);
+  instruction.errorOffset = _offset;
+  append(instruction);
+}
+
+void CompiledProgram::compileCounter() throw (InterpreterException)
+{
+  Instruction instruction(currentEntity() == LCDOp_Dsz ? Op_Dsz : Op_Isz, currentEntity(), _offset);
+  readEntity(); // Pass the "Dsz" or "Isz"
+  readDestination(instruction);
+  instruction.operand = instruction.variable - LCDChar_A; // Slot without the array index
+  _pendingCounter = append(instruction);
+}
+
+int CompiledProgram::readCipherArgument() throw (InterpreterException)
+{
+  readEntity(); // Pass the instruction
+  if (!isCipher(currentEntity()))
+    throw InterpreterException(Error_Argument, _offset);
+  int cipher = readEntity();
+  if (!atStatementEnd())
+    throw InterpreterException(Error_Argument, _offset);
+  return cipher - LCDChar_0;
+}
+
+void CompiledProgram::readDestination(Instruction &instruction) throw (InterpreterException)
+{
+  // A variable or an array var
+  if (!isAlpha(currentEntity()))
+    throw InterpreterException(Error_Syntax, _offset);
+  instruction.variable = readEntity();
+
+  if (eatEntity(LCDChar_OpenBracket)) // Array var
+  {
+    instruction.indexExpression = compileExpressionAt();
+    if (!eatEntity(LCDChar_CloseBracket))
+      throw InterpreterException(Error_Syntax, _offset);
+  }
+
+  // Next entity is separator or end
+  if (!atStatementEnd())
+    throw InterpreterException(Error_Syntax, _offset);
+  instruction.errorOffset = _offset;
+}
+
+int CompiledProgram::currentEntity() const
+{
+  if (_offset >= _rawSteps->count())
+    return -1;
+  return (*_rawSteps)[_offset];
+}
+
+int CompiledProgram::readEntity()
+{
+  if (_offset >= _rawSteps->count())
+    return -1;
+  return (*_rawSteps)[_offset++];
+}
+
+bool CompiledProgram::eatEntity(int entity)
+{
+  if (currentEntity() == entity)
+  {
+    readEntity();
+    return true;
+  } else
+    return false;
+}
+
+bool CompiledProgram::atStatementEnd() const
+{
+  return isSeparator(currentEntity()) || currentEntity() == -1;
+}
+
+void CompiledProgram::moveOffsetToNextSeparator()
+{
+  while (!atStatementEnd())
+    readEntity();
+}
+
+int CompiledProgram::append(const Instruction &instruction)
+{
+  _instructions << instruction;
+  return _instructions.count() - 1;
+}
+
+int CompiledProgram::appendStrings(const QList<TextLine> &lines)
+{
+  _strings << lines;
+  return _strings.count() - 1;
+}
+
+int CompiledProgram::compileExpressionAt() throw (InterpreterException)
+{
+  _expressions << _expressionSolver.compile(*_rawSteps, _offset);
+  _offset = _expressions.last().endOffset();
+  return _expressions.count() - 1;
+}
@@ -0,0 +1,103 @@
+#ifndef COMPILED_PROGRAM_H
+#define COMPILED_PROGRAM_H
+
+#include <QVector>
+
+#include "expression_solver.h"
+#include "misc.h"
+
+// Instruction array compiled once from the raw entities of a program.
+// Errors found while compiling become Op_Error instructions so they are only reported
+// when the faulty statement is reached, like the calculator does.
+// Statement boundaries are resolved while compiling: false conditions, Dsz/Isz and Goto jump to an
+// instruction index and strings are already split into lines, so nothing scans the raw steps at run time.
+class CompiledProgram
+{
+public:
+  enum OpCode {
+    Op_Nop,        // Empty statement
+    Op_Display,    // Display the lines <strings(operand)>
+    Op_Input,      // Display the lines <strings(operand)>, then store the user input into the destination
+    Op_Expression, // Solve <expression>, then store it into the destination if any
+    Op_Condition,  // Compare <expression> and <expression2> with <comparison>, jump to <jump> if false
+    Op_Goto,       // Jump to <jump>
+    Op_Prog,       // Call the program <operand>
+    Op_AngleMode,  // Change the angle mode, <operand> is LCDOp_Deg, LCDOp_Rad or LCDOp_Gra
+    Op_Defm,       // Allocate <operand> extra variables (-1 to only display them)
+    Op_Dsz,        // Decrement the variable slot <operand> (+ <indexExpression>), jump to <jump> if it becomes 0
+    Op_Isz,        // Increment the variable slot <operand> (+ <indexExpression>), jump to <jump> if it becomes 0
+    Op_Pause,      // RBTriangle separator: display the last result and wait for validation
+    Op_Error,      // Raise the error <operand>
+    Op_End         // End of the program
+  };
+
+  class Instruction
+  {
+  public:
+    Instruction(OpCode o = Op_Nop, int e = -1, int off = 0) :
+      op(o), entity(e), offset(off), errorOffset(off), operand(-1), expression(-1), expression2(-1), comparison(-1),
+      jump(-1), variable(-1), indexExpression(-1) {}
+
+    OpCode op;
+    int entity;      // First entity of the statement
+    int offset;      // Offset of the statement in the raw steps
+    int errorOffset; // Offset reported by the errors of this instruction
+    int operand;
+    int expression;      // Expression index
+    int expression2;     // Expression index
+    int comparison;      // Comparison entity of Op_Condition
+    int jump;            // Instruction index
+    int variable;        // Destination variable (LCDChar_A -> LCDChar_Z), -1 if none
+    int indexExpression; // Expression index of the destination array index, -1 if none
+  };
+
+  CompiledProgram() { clear(); }
+
+  void compile(const TextLine &rawSteps);
+  void clear(); // Becomes an empty program
+
+  int count() const { return _instructions.count(); }
+  const Instruction &at(int index) const { return _instructions.at(index); }
+  const QList<TextLine> &strings(int index) const { return _strings.at(index); }
+  const CompiledExpression &expression(int index) const { return _expressions.at(index); }
+
+  // Label table: instruction index following "Lbl <cipher>", -1 if the label can't be reached
+  int labelInstruction(int cipher) const { return _labels[cipher]; }
+
+private:
+  QVector<Instruction> _instructions;
+  QList<QList<TextLine> > _strings;
+  QVector<CompiledExpression> _expressions; // Each expression is compiled once
+  int _labels[10];
+
+  // Compilation state
+  const TextLine *_rawSteps;
+  int _offset;
+  int _pendingCounter; // Dsz/Isz instruction waiting for the end of its statement, -1 if none
+  ExpressionSolver _expressionSolver;
+
+  int currentEntity() const; // Returns -1 at the end
+  int readEntity(); // Returns -1 at the end
+  bool eatEntity(int entity); // Returns true if entity is eaten
+  bool atStatementEnd() const; // Separator or end
+  void moveOffsetToNextSeparator();
+
+  int append(const Instruction &instruction); // Returns the instruction index
+  int appendStrings(const QList<TextLine> &lines);
+  int compileExpressionAt() throw (InterpreterException); // Returns the expression index
+
+  // Returns true if the statement is a condition ("=>" is followed by another statement)
+  bool compileStatement() throw (InterpreterException);
+  void compileString() throw (InterpreterException);
+  void compileInput(QList<TextLine> lines, int entity, int offset) throw (InterpreterException);
+  bool compileExpression() throw (InterpreterException);
+  void compileLabel() throw (InterpreterException);
+  void compileGoto() throw (InterpreterException);
+  void compileProg() throw (InterpreterException);
+  void compileDefm() throw (InterpreterException);
+  void compileCounter() throw (InterpreterException);
+  int readCipherArgument() throw (InterpreterException);
+  void readDestination(Instruction &instruction) throw (InterpreterException);
+};
+
+#endif
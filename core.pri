@@ -0,0 +1,35 @@
+# Emulator core: interpreter, expression solver and memory, only depends on QtCore
+DEPENDPATH += $$PWD
+INCLUDEPATH += $$PWD
+
+HEADERS += $$PWD/misc.h \
+  $$PWD/memory.h \
+  $$PWD/program_parser.h \
+  $$PWD/emulator_context.h \
+  $$PWD/interpreter.h \
+  $$PWD/execution_profiler.h \
+  $$PWD/execution_history.h \
+  $$PWD/execution_trace.h \
+  $$PWD/input_provider.h \
+  $$PWD/batch_executor.h \
+  $$PWD/compiled_program.h \
+  $$PWD/expression_solver.h \
+  $$PWD/compiled_expression.h \
+  $$PWD/speed_governor.h \
+  $$PWD/spsc_channel.h \
+  $$PWD/token.h
+
+SOURCES += $$PWD/misc.cpp \
+  $$PWD/memory.cpp \
+  $$PWD/program_parser.cpp \
+  $$PWD/emulator_context.cpp \
+  $$PWD/interpreter.cpp \
+  $$PWD/execution_profiler.cpp \
+  $$PWD/execution_history.cpp \
+  $$PWD/execution_trace.cpp \
+  $$PWD/input_provider.cpp \
+  $$PWD/batch_executor.cpp \
+  $$PWD/compiled_program.cpp \
+  $$PWD/expression_solver.cpp \
+  $$PWD/speed_governor.cpp \
+  $$PWD/token.cpp
@@ -0,0 +1,6 @@
+TEMPLATE = lib
+TARGET = fx7500g-core
+CONFIG += staticlib debug
+QT -= gui
+
+include(../core.pri)
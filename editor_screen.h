@@ -30,6 +30,8 @@ protected:
   void feedScreen(); // <_screen> of Shell ancestor is filled with <_lines> and <_promptLine>
   void carriageReturn();
   void moveCursor(int newLineIndex, int newOffset, bool *scrolled = 0); // Move cursor can invoke scrollUp() or scrollDown() if cursor is out of the screen
+  int cursorLineIndex() const { return _cursorLineIndex; }
+  int cursorOffset() const { return _cursorOffset; }
   void initTopLineIndex();
   void clearLines(); // Clear the screen
 
@@ -0,0 +1,59 @@
+#include <QDateTime>
+
+#include "memory.h"
+
+#include "emulator_context.h"
+
+EmulatorContext *EmulatorContext::_defaultContext = 0;
+
+EmulatorContext::EmulatorContext(quint32 randomSeed) :
+  _memory(new Memory),
+  _shared(false),
+  _angleMode(Deg),
+  _randomState(randomSeed)
+{
+}
+
+EmulatorContext::EmulatorContext(Memory *memory, quint32 randomSeed) :
+  _memory(memory),
+  _shared(true),
+  _angleMode(Deg),
+  _randomState(randomSeed)
+{
+}
+
+EmulatorContext::~EmulatorContext()
+{
+  if (!_shared)
+    delete _memory;
+}
+
+EmulatorContext &EmulatorContext::defaultContext()
+{
+  if (!_defaultContext)
+    _defaultContext = new EmulatorContext(&Memory::instance(), QDateTime::currentMSecsSinceEpoch() / 1000);
+
+  return *_defaultContext;
+}
+
+AngleMode EmulatorContext::angleMode() const
+{
+  if (_shared)
+    return CalculatorState::instance().angleMode();
+  return _angleMode;
+}
+
+void EmulatorContext::setAngleMode(AngleMode value)
+{
+  if (_shared)
+    CalculatorState::instance().setAngleMode(value);
+  else
+    _angleMode = value;
+}
+
+double EmulatorContext::random()
+{
+  // Linear congruential generator, the high bits are the random ones
+  _randomState = _randomState * 1103515245 + 12345;
+  return ((_randomState >> 16) % 1000) / 1000.0;
+}
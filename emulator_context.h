@@ -0,0 +1,43 @@
+#ifndef EMULATOR_CONTEXT_H
+#define EMULATOR_CONTEXT_H
+
+#include <QtGlobal>
+
+#include "misc.h"
+
+class Memory;
+
+// Everything a calculator session owns: memory (variables and programs), angle mode and Ran# state.
+// Independent contexts can be interpreted concurrently, each one in its own thread.
+class EmulatorContext
+{
+public:
+  EmulatorContext(quint32 randomSeed = 1); // Fresh memory (no programs) in Deg mode
+  ~EmulatorContext();
+
+  // Context of the calculator window, shares Memory::instance() and CalculatorState::instance()
+  static EmulatorContext &defaultContext();
+
+  Memory &memory() { return *_memory; }
+  const Memory &memory() const { return *_memory; }
+
+  AngleMode angleMode() const;
+  void setAngleMode(AngleMode value);
+
+  double random(); // Ran#: 0.000 to 0.999
+  quint32 randomState() const { return _randomState; } // Seed of the next Ran#
+  void setRandomSeed(quint32 value) { _randomState = value; }
+
+private:
+  Q_DISABLE_COPY(EmulatorContext)
+
+  static EmulatorContext *_defaultContext;
+  Memory *_memory;
+  bool _shared; // Memory and modes are the singleton ones
+  AngleMode _angleMode;
+  quint32 _randomState;
+
+  EmulatorContext(Memory *memory, quint32 randomSeed);
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "memory.h"
+
+#include "execution_history.h"
+
+ExecutionHistory::ExecutionHistory(qint64 interval, int maxCheckpoints) :
+  _initialInterval(qMax(interval, (qint64) 1)),
+  _maxCheckpoints(qMax(maxCheckpoints, 2)),
+  _written(Memory::variablesCount)
+{
+  clear();
+}
+
+void ExecutionHistory::clear()
+{
+  _interval = _initialInterval;
+  _checkpoints.clear();
+  _nextCheckpoint = 0;
+  _end = 0;
+  _inputs.clear();
+  clearWritten();
+  _fullNeeded = true;
+}
+
+void ExecutionHistory::checkpoint(Checkpoint &checkpoint, Memory &memory)
+{
+  checkpoint.inputCount = _inputs.count();
+  checkpoint.extraVarCount = memory.extraVarCount();
+  int count = 26 + checkpoint.extraVarCount;
+
+  int sinceFull = 0;
+  for (int i = _checkpoints.count() - 1; i >= 0 && !_checkpoints[i].full; --i)
+    ++sinceFull;
+  checkpoint.full = _fullNeeded || !_checkpoints.count() || sinceFull >= _fullInterval - 1;
+  if (checkpoint.full)
+  {
+    for (int i = 0; i < count; ++i)
+      checkpoint.values << *memory.variableSlot(i);
+  } else
+  {
+    foreach (int slot, _writtenSlots)
+      if (slot < count)
+      {
+        checkpoint.variables << slot;
+        checkpoint.values << *memory.variableSlot(slot);
+      }
+  }
+  clearWritten();
+  _fullNeeded = false;
+
+  _checkpoints << checkpoint;
+  _nextCheckpoint = checkpoint.step + _interval;
+  if (_checkpoints.count() > _maxCheckpoints)
+    thin();
+}
+
+int ExecutionHistory::checkpointBefore(qint64 step) const
+{
+  int first = 0;
+  int last = _checkpoints.count() - 1;
+  int result = -1;
+  while (first <= last)
+  {
+    int middle = (first + last) / 2;
+    if (_checkpoints[middle].step <= step)
+    {
+      result = middle;
+      first = middle + 1;
+    } else
+      last = middle - 1;
+  }
+  return result;
+}
+
+void ExecutionHistory::restoreVariables(int index, Memory &memory) const
+{
+  int full = index;
+  while (!_checkpoints[full].full) // The first checkpoint is always full
+    --full;
+
+  memory.setExtraVarCount(_checkpoints[index].extraVarCount);
+  for (int i = full; i <= index; ++i)
+  {
+    const Checkpoint &checkpoint = _checkpoints[i];
+    for (int j = 0; j < checkpoint.values.count(); ++j)
+      memory.setVariable(checkpoint.full ? j : checkpoint.variables[j], checkpoint.values[j]);
+  }
+}
+
+void ExecutionHistory::truncate(qint64 step, int inputCount)
+{
+  while (_checkpoints.count() && _checkpoints.last().step > step)
+    _checkpoints.removeLast();
+  _inputs = _inputs.mid(0, inputCount);
+  _end = step;
+  _nextCheckpoint = _checkpoints.count() ? _checkpoints.last().step + _interval : 0;
+  clearWritten();
+  _fullNeeded = true; // The writes since the last checkpoint are lost
+}
+
+void ExecutionHistory::clearWritten()
+{
+  foreach (int slot, _writtenSlots)
+    _written.clearBit(slot);
+  _writtenSlots.resize(0);
+}
+
+void ExecutionHistory::thin()
+{
+  // The first checkpoint and the last one are kept
+  for (int i = (_checkpoints.count() - 2) | 1; i > 0; i -= 2)
+    if (i + 1 < _checkpoints.count())
+      merge(i);
+  _interval *= 2;
+  _nextCheckpoint = _checkpoints.last().step + _interval;
+}
+
+void ExecutionHistory::merge(int index)
+{
+  const Checkpoint &removed = _checkpoints[index];
+  Checkpoint &next = _checkpoints[index + 1];
+  if (removed.full && !next.full) // Then the next one gets all the variables
+  {
+    QVector<double> values = removed.values;
+    for (int i = 0; i < next.variables.count(); ++i)
+      values[next.variables[i]] = next.values[i];
+    next.values = values;
+    next.variables.clear();
+    next.full = true;
+  } else if (!next.full) // Variables written before <removed> and not since
+  {
+    QBitArray nextVariables(Memory::variablesCount);
+    foreach (int variable, next.variables)
+      nextVariables.setBit(variable);
+    for (int i = 0; i < removed.variables.count(); ++i)
+      if (!nextVariables.testBit(removed.variables[i]))
+      {
+        next.variables << removed.variables[i];
+        next.values << removed.values[i];
+      }
+  }
+  _checkpoints.removeAt(index);
+}
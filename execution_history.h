@@ -0,0 +1,96 @@
+#ifndef EXECUTION_HISTORY_H
+#define EXECUTION_HISTORY_H
+
+#include <QBitArray>
+#include <QVector>
+
+#include "misc.h"
+
+class Memory;
+
+// Periodic checkpoints of a run, so that Interpreter::seek() can go back to any statement by interpreting
+// again from the last checkpoint before it, see Interpreter::setHistory().
+// A checkpoint only keeps the variables written since the previous one, every <_fullInterval> checkpoints
+// keep them all. Long runs are thinned: once <maxCheckpoints> are taken, every other one is merged into
+// the next one and the interval doubles.
+class ExecutionHistory
+{
+public:
+  class Checkpoint
+  {
+  public:
+    Checkpoint() : step(0), program(-1), instruction(0), lastResult(0.0), displayLastNumber(true),
+      displayDefm(false), angleMode(Deg), randomState(0), extraVarCount(0), inputCount(0), full(false) {}
+
+    qint64 step; // Statements executed before
+    int program; // -1 for the main program
+    int instruction;
+    QVector<int> callStack; // Program and instruction pairs, the oldest call first
+    double lastResult;
+    bool displayLastNumber;
+    bool displayDefm;
+    AngleMode angleMode;
+    quint32 randomState;
+    int extraVarCount;
+    int inputCount; // Inputs consumed before
+
+    bool full; // <values> holds all the variables, else the ones of <variables>
+    QVector<int> variables;
+    QVector<double> values;
+  };
+
+  ExecutionHistory(qint64 interval = 4096, int maxCheckpoints = 1024);
+
+  void clear(); // Called by the interpreter when a run starts
+
+  // Recording, called by the interpreter
+  qint64 nextCheckpoint() const { return _nextCheckpoint; } // In statements
+  void checkpoint(Checkpoint &checkpoint, Memory &memory); // <checkpoint> is given without the variables
+  void write(int slot);
+  void input(const TextLine &textLine) { _inputs << textLine; }
+  void defm() { _fullNeeded = true; } // The variables allocated by Defm are reset without write()
+  void setEnd(qint64 step) { _end = step; }
+
+  qint64 interval() const { return _interval; }
+  qint64 end() const { return _end; } // Statements of the recorded run which can be seeked
+  int checkpointCount() const { return _checkpoints.count(); }
+  const Checkpoint &checkpointAt(int index) const { return _checkpoints[index]; }
+  int checkpointBefore(qint64 step) const; // Index of the last checkpoint at <step> or before, -1 if none
+
+  void restoreVariables(int index, Memory &memory) const; // Variables as they were at checkpoint <index>
+  QList<TextLine> inputs(int from) const { return _inputs.mid(from); }
+
+  // Forgets what was recorded after <step>, once <inputCount> inputs were consumed. The run goes on from there
+  void truncate(qint64 step, int inputCount);
+
+private:
+  static const int _fullInterval = 32;
+
+  qint64 _initialInterval;
+  qint64 _interval;
+  int _maxCheckpoints;
+  QList<Checkpoint> _checkpoints;
+  qint64 _nextCheckpoint;
+  qint64 _end;
+  QList<TextLine> _inputs;
+  bool _fullNeeded; // The written variables are unknown
+
+  // Variables written since the last checkpoint
+  QBitArray _written;
+  QVector<int> _writtenSlots;
+
+  void clearWritten();
+  void thin();
+  void merge(int index); // Removes checkpoint <index>, which becomes part of the next one
+};
+
+inline void ExecutionHistory::write(int slot)
+{
+  if (!_written.testBit(slot))
+  {
+    _written.setBit(slot);
+    _writtenSlots << slot;
+  }
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include <algorithm>
+
+#include "memory.h"
+
+#include "execution_profiler.h"
+
+ExecutionProfiler::ExecutionProfiler()
+{
+  clear();
+  _timer.start();
+}
+
+void ExecutionProfiler::clear()
+{
+  for (int i = 0; i < _programCount; ++i)
+  {
+    _offsets[i].clear();
+    _programs[i] = Sample();
+  }
+  for (int i = 0; i <= CompiledProgram::Op_End; ++i)
+    _opCodes[i] = Sample();
+  _currentOffset = 0;
+  _currentOpCode = 0;
+  _currentProgram = 0;
+  _start = 0;
+}
+
+void ExecutionProfiler::statement(int program, const CompiledProgram::Instruction &instruction)
+{
+  stop();
+
+  _currentOffset = &_offsets[program + 1][instruction.offset];
+  _currentOpCode = &_opCodes[instruction.op];
+  _currentProgram = &_programs[program + 1];
+  _currentOffset->count++;
+  _currentOpCode->count++;
+  _currentProgram->count++;
+  _start = _timer.nsecsElapsed();
+}
+
+void ExecutionProfiler::stop()
+{
+  if (!_currentOffset)
+    return;
+
+  qint64 nsecs = _timer.nsecsElapsed() - _start;
+  _currentOffset->nsecs += nsecs;
+  _currentOpCode->nsecs += nsecs;
+  _currentProgram->nsecs += nsecs;
+  _currentOffset = 0;
+}
+
+QString ExecutionProfiler::opCodeName(CompiledProgram::OpCode op)
+{
+  switch (op)
+  {
+  case CompiledProgram::Op_Nop: return "Empty";
+  case CompiledProgram::Op_Display: return "Display";
+  case CompiledProgram::Op_Input: return "Input";
+  case CompiledProgram::Op_Expression: return "Expression";
+  case CompiledProgram::Op_Condition: return "Condition";
+  case CompiledProgram::Op_Goto: return "Goto";
+  case CompiledProgram::Op_Prog: return "Prog";
+  case CompiledProgram::Op_AngleMode: return "Angle mode";
+  case CompiledProgram::Op_Defm: return "Defm";
+  case CompiledProgram::Op_Dsz: return "Dsz";
+  case CompiledProgram::Op_Isz: return "Isz";
+  case CompiledProgram::Op_Pause: return "Pause";
+  case CompiledProgram::Op_Error: return "Error";
+  case CompiledProgram::Op_End: return "End";
+  default: return QString();
+  }
+}
+
+static QString programName(int program)
+{
+  return program < 0 ? QString("Main") : QString("Prog %1").arg(program);
+}
+
+static QString sampleColumns(const ExecutionProfiler::Sample &sample)
+{
+  return QString("%1 %2").arg(sample.count, 10).arg(sample.nsecs / 1000000.0, 12, 'f', 3);
+}
+
+QString ExecutionProfiler::report(const QList<TextLine> &mainProgram, Memory &memory, int hotspotCount) const
+{
+  QString result;
+  QString header = QString("%1 %2\n").arg("Count", 10).arg("Time (ms)", 12);
+
+  result += QString("%1 %2").arg("Program", -12).arg(header);
+  for (int i = 0; i < _programCount; ++i)
+    if (_programs[i].count)
+      result += QString("%1 %2\n").arg(programName(i - 1), -12).arg(sampleColumns(_programs[i]));
+
+  result += QString("\n%1 %2").arg("Statement", -12).arg(header);
+  for (int op = 0; op <= CompiledProgram::Op_End; ++op)
+    if (_opCodes[op].count)
+      result += QString("%1 %2\n").arg(opCodeName((CompiledProgram::OpCode) op), -12).arg(sampleColumns(_opCodes[op]));
+
+  QList<Hotspot> hotspots;
+  for (int i = 0; i < _programCount; ++i)
+  {
+    QHashIterator<int, Sample> it(_offsets[i]);
+    while (it.hasNext())
+    {
+      it.next();
+      Hotspot hotspot;
+      hotspot.program = i - 1;
+      hotspot.offset = it.key();
+      hotspot.sample = it.value();
+      hotspots << hotspot;
+    }
+  }
+  std::sort(hotspots.begin(), hotspots.end());
+
+  result += QString("\n%1 %2 %3").arg("Program", -12).arg("Line:Col", -10).arg(header);
+  for (int i = 0; i < hotspots.count() && i < hotspotCount; ++i)
+  {
+    const Hotspot &hotspot = hotspots[i];
+    const QList<TextLine> &lines = hotspot.program < 0 ? mainProgram : memory.programAt(hotspot.program)->steps();
+    QString position = QString::number(hotspot.offset);
+    if (lines.count())
+    {
+      int line, step;
+      getLineAndStep(lines, hotspot.offset, line, step);
+      position = QString("%1:%2").arg(line + 1).arg(step + 1); // Counted from 1
+    }
+    result += QString("%1 %2 %3\n").arg(programName(hotspot.program), -12).arg(position, -10).arg(sampleColumns(hotspot.sample));
+  }
+  return result;
+}
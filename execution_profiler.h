@@ -0,0 +1,72 @@
+#ifndef EXECUTION_PROFILER_H
+#define EXECUTION_PROFILER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+
+#include "compiled_program.h"
+#include "misc.h"
+
+class Memory;
+
+// Counts the executed statements and the time spent in them, see Interpreter::setProfiler().
+// The time of a statement lasts until the next one starts, so it includes input waits and the
+// speed governor sleeps: profile in unthrottled mode to get the host time.
+class ExecutionProfiler
+{
+public:
+  class Sample
+  {
+  public:
+    Sample() : count(0), nsecs(0) {}
+
+    qint64 count;
+    qint64 nsecs;
+  };
+
+  ExecutionProfiler();
+
+  void clear();
+
+  // Called by the interpreter before each statement of <program> (-1 for the main program), not for the
+  // program ends nor the pauses: the wait of a pause counts in the statement before it
+  void statement(int program, const CompiledProgram::Instruction &instruction);
+  void stop(); // Ends the time of the current statement
+
+  // Samples per raw steps offset
+  const QHash<int, Sample> &offsets(int program) const { return _offsets[program + 1]; }
+  const Sample &opCode(CompiledProgram::OpCode op) const { return _opCodes[op]; }
+  const Sample &program(int program) const { return _programs[program + 1]; }
+
+  // Text report, <mainProgram> is the program given to the interpreter and the others are read in <memory>
+  QString report(const QList<TextLine> &mainProgram, Memory &memory, int hotspotCount = 20) const;
+
+  static QString opCodeName(CompiledProgram::OpCode op);
+
+private:
+  class Hotspot
+  {
+  public:
+    int program;
+    int offset;
+    Sample sample;
+
+    bool operator<(const Hotspot &other) const { return sample.nsecs > other.sample.nsecs; } // Slowest first
+  };
+
+  static const int _programCount = 11; // Main program then 0-9
+
+  QHash<int, Sample> _offsets[_programCount];
+  Sample _opCodes[CompiledProgram::Op_End + 1];
+  Sample _programs[_programCount];
+  QElapsedTimer _timer;
+
+  // Current statement
+  Sample *_currentOffset;
+  Sample *_currentOpCode;
+  Sample *_currentProgram;
+  qint64 _start;
+};
+
+#endif
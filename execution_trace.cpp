@@ -0,0 +1,302 @@
+#include <limits.h>
+#include <string.h>
+
+#include <QIODevice>
+#include <QtEndian>
+
+#include "input_provider.h"
+#include "interpreter.h"
+
+#include "execution_trace.h"
+
+static const char traceMagic[] = "FX7T";
+static const int traceVersion = 2; // 1 had a statement event for the program ends and the pauses
+
+bool ExecutionTrace::Event::operator==(const Event &other) const
+{
+  if (type != other.type || value != other.value)
+    return false;
+  switch (type)
+  {
+  case Event_Store: return !memcmp(&number, &other.number, sizeof(number)); // Bit-identical
+  case Event_Input: return textLine == other.textLine;
+  default: return true;
+  }
+}
+
+QString ExecutionTrace::Event::toString() const
+{
+  switch (type)
+  {
+  case Event_Statement: return QString("Step %1").arg(value);
+  case Event_Program: return value < 0 ? QString("Main program") : QString("Prog %1").arg(value);
+  case Event_Goto: return QString("Goto instruction %1").arg(value);
+  case Event_Store: return QString("%1 -> slot %2").arg(number, 0, 'g', 17).arg(value);
+  case Event_Input: return QString("Input \"%1\"").arg(charsToString(textLine.charLine()));
+  default: return QString("End");
+  }
+}
+
+ExecutionTrace::ExecutionTrace(int capacity)
+{
+  allocate(capacity);
+}
+
+void ExecutionTrace::allocate(int capacity)
+{
+  _chunkSize = qMax(capacity / _chunkCount, (int) _minimumChunkSize); // Not bound to a reference, it has no definition
+  _buffer = QVector<uchar>(_chunkCount * _chunkSize);
+  _data = _buffer.data();
+  clear();
+}
+
+void ExecutionTrace::clear()
+{
+  _firstChunk = 0;
+  _currentChunk = 0;
+  _write = _data;
+  _writeEnd = _data + _chunkSize;
+  _dropped = false;
+}
+
+void ExecutionTrace::store(int slot, double number)
+{
+  if (_writeEnd - _write >= 2 * _maxVarintSize)
+  {
+    appendVarint(((quint64) slot << 3) | Event_Store);
+    appendVarint(numberToBits(number));
+    return;
+  }
+
+  uchar bytes[2 * _maxVarintSize];
+  int count = encode(((quint64) slot << 3) | Event_Store, bytes);
+  count += encode(numberToBits(number), bytes + count);
+  append(bytes, count);
+}
+
+void ExecutionTrace::input(const TextLine &textLine)
+{
+  QVector<uchar> bytes((textLine.count() + 1) * _maxVarintSize);
+  int count = encode(((quint64) textLine.count() << 3) | Event_Input, bytes.data());
+  foreach (int entity, textLine)
+    count += encode(entity, bytes.data() + count);
+  append(bytes.constData(), count);
+}
+
+int ExecutionTrace::size() const
+{
+  int result = 0;
+  for (int chunk = _firstChunk; chunk != _currentChunk; chunk = (chunk + 1) % _chunkCount)
+    result += _chunkUsed[chunk];
+  return result + (_write - chunkBegin(_currentChunk));
+}
+
+QList<ExecutionTrace::Event> ExecutionTrace::events() const
+{
+  QList<Event> result;
+  for (int chunk = _firstChunk; ; chunk = (chunk + 1) % _chunkCount)
+  {
+    const uchar *data = chunkBegin(chunk);
+    const uchar *end = chunkEnd(chunk);
+    Event event;
+    while (data < end && readEvent(data, end, event))
+      result << event;
+    if (chunk == _currentChunk)
+      break;
+  }
+  return result;
+}
+
+int ExecutionTrace::replay(Interpreter &interpreter, Event *expected, Event *actual) const
+{
+  // The start of the run is missing, it can't be run again
+  if (!isComplete())
+    return incompleteTrace;
+
+  QList<Event> recorded = events();
+  QList<TextLine> inputs;
+  qint64 statements = 0;
+  foreach (const Event &event, recorded)
+  {
+    if (event.type == Event_Input)
+      inputs << event.textLine;
+    else if (event.type == Event_Statement)
+      ++statements;
+  }
+
+  // The replay breaks where the recorded run ended, even if it would loop forever
+  QueueInputProvider provider(inputs);
+  ExecutionTrace trace(capacity() * 2);
+  InputProvider *inputProvider = interpreter.inputProvider();
+  ExecutionTrace *previousTrace = interpreter.trace();
+  qint64 stepBudget = interpreter.stepBudget();
+  interpreter.setInputProvider(&provider);
+  interpreter.setTrace(&trace);
+  interpreter.setStepBudget(qMax(statements, (qint64) 1));
+  interpreter.interpret();
+  interpreter.setInputProvider(inputProvider);
+  interpreter.setTrace(previousTrace);
+  interpreter.setStepBudget(stepBudget);
+
+  QList<Event> replayed = trace.events();
+  for (int i = 0; i < qMax(recorded.count(), replayed.count()); ++i)
+  {
+    Event recordedEvent = i < recorded.count() ? recorded[i] : Event();
+    Event replayedEvent = i < replayed.count() ? replayed[i] : Event();
+    if (recordedEvent != replayedEvent)
+    {
+      if (expected)
+        *expected = recordedEvent;
+      if (actual)
+        *actual = replayedEvent;
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool ExecutionTrace::save(QIODevice *device) const
+{
+  QVector<uchar> data(10);
+  memcpy(data.data(), traceMagic, 4);
+  data[4] = traceVersion;
+  data[5] = _dropped;
+  qToLittleEndian<quint32>(size(), data.data() + 6);
+  for (int chunk = _firstChunk; ; chunk = (chunk + 1) % _chunkCount)
+  {
+    for (const uchar *byte = chunkBegin(chunk); byte < chunkEnd(chunk); ++byte)
+      data << *byte;
+    if (chunk == _currentChunk)
+      break;
+  }
+  return device->write((const char *) data.constData(), data.count()) == data.count();
+}
+
+bool ExecutionTrace::load(QIODevice *device)
+{
+  uchar header[10];
+  if (device->read((char *) header, 10) != 10 || memcmp(header, traceMagic, 4) || header[4] != traceVersion)
+    return false;
+
+  int size = qFromLittleEndian<quint32>(header + 6);
+  if (size < 0)
+    return false;
+  QVector<uchar> data(size);
+  if (device->read((char *) data.data(), size) != size)
+    return false;
+
+  // Large enough for the events to be spread over the chunks again
+  allocate(qMax(capacity(), 2 * size + _chunkCount * _minimumChunkSize));
+  const uchar *event = data.constData();
+  const uchar *end = event + size;
+  Event decoded;
+  while (event < end)
+  {
+    const uchar *next = event;
+    if (!readEvent(next, end, decoded))
+    {
+      clear();
+      return false;
+    }
+    append(event, next - event);
+    event = next;
+  }
+  _dropped = _dropped || header[5];
+  return true;
+}
+
+const uchar *ExecutionTrace::chunkEnd(int chunk) const
+{
+  if (chunk == _currentChunk)
+    return _write;
+  return chunkBegin(chunk) + _chunkUsed[chunk];
+}
+
+void ExecutionTrace::nextChunk()
+{
+  _chunkUsed[_currentChunk] = _write - chunkBegin(_currentChunk);
+  _currentChunk = (_currentChunk + 1) % _chunkCount;
+  if (_currentChunk == _firstChunk)
+  {
+    _firstChunk = (_firstChunk + 1) % _chunkCount;
+    _dropped = true;
+  }
+  _write = _data + _currentChunk * _chunkSize;
+  _writeEnd = _write + _chunkSize;
+}
+
+void ExecutionTrace::append(const uchar *bytes, int count)
+{
+  if (count > _chunkSize) // Can't be kept
+  {
+    _dropped = true;
+    return;
+  }
+  if (_writeEnd - _write < count)
+    nextChunk();
+  memcpy(_write, bytes, count);
+  _write += count;
+}
+
+int ExecutionTrace::encode(quint64 value, uchar *bytes)
+{
+  int count = 0;
+  while (value >= 0x80)
+  {
+    bytes[count++] = (uchar) (value | 0x80);
+    value >>= 7;
+  }
+  bytes[count++] = (uchar) value;
+  return count;
+}
+
+quint64 ExecutionTrace::decode(const uchar *&data, const uchar *end)
+{
+  quint64 value = 0;
+  for (int shift = 0; data < end && shift < 64; shift += 7)
+  {
+    uchar byte = *data++;
+    value |= (quint64) (byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      break;
+  }
+  return value;
+}
+
+bool ExecutionTrace::readEvent(const uchar *&data, const uchar *end, Event &event)
+{
+  quint64 header = decode(data, end);
+  if ((header & 7) >= Event_End || (header >> 3) > INT_MAX)
+    return false;
+
+  event = Event((EventType) (header & 7), (int) (header >> 3));
+  switch (event.type)
+  {
+  case Event_Program: event.value--; break;
+  case Event_Store: event.number = bitsToNumber(decode(data, end)); break;
+  case Event_Input:
+    if (event.value > end - data) // Each entity takes a byte at least
+      return false;
+    for (int i = 0; i < event.value; ++i)
+      event.textLine << (int) decode(data, end);
+    event.value = 0;
+    break;
+  default:;
+  }
+  return true;
+}
+
+quint64 ExecutionTrace::numberToBits(double number)
+{
+  quint64 bits;
+  memcpy(&bits, &number, sizeof(bits));
+  return qbswap(bits);
+}
+
+double ExecutionTrace::bitsToNumber(quint64 bits)
+{
+  bits = qbswap(bits);
+  double number;
+  memcpy(&number, &bits, sizeof(number));
+  return number;
+}
@@ -0,0 +1,132 @@
+#ifndef EXECUTION_TRACE_H
+#define EXECUTION_TRACE_H
+
+#include <QVector>
+
+#include "misc.h"
+
+class QIODevice;
+class Interpreter;
+
+// Compact record of a run, see Interpreter::setTrace(). Events are varint encoded into a fixed size ring of
+// chunks and the oldest chunk is forgotten once all are full, so the trace can stay enabled in production.
+class ExecutionTrace
+{
+public:
+  enum EventType {
+    Event_Statement, // Statement at the raw steps offset <value>
+    Event_Program,   // Switch to the program <value>, -1 for the main program
+    Event_Goto,      // Jump to the instruction <value>
+    Event_Store,     // <number> written into the variable slot <value> (A is 0)
+    Event_Input,     // <textLine> consumed by a "?"
+    Event_End        // No more events, only reported by replay()
+  };
+
+  class Event
+  {
+  public:
+    Event(EventType t = Event_End, int v = 0, double n = 0.0) : type(t), value(v), number(n) {}
+
+    bool operator==(const Event &other) const;
+    bool operator!=(const Event &other) const { return !(*this == other); }
+    QString toString() const;
+
+    EventType type;
+    int value;
+    double number;
+    TextLine textLine;
+  };
+
+  ExecutionTrace(int capacity = 65536); // In bytes
+
+  void clear(); // Called by the interpreter when a run starts
+
+  // Recording, called by the interpreter
+  void statement(int offset) { appendHeader(Event_Statement, offset); }
+  void program(int program) { appendHeader(Event_Program, program + 1); }
+  void jump(int instruction) { appendHeader(Event_Goto, instruction); }
+  void store(int slot, double number);
+  void input(const TextLine &textLine);
+
+  int capacity() const { return _chunkCount * _chunkSize; }
+  int size() const; // Bytes used
+  bool isComplete() const { return !_dropped; } // Nothing dropped since clear()
+  QList<Event> events() const; // Oldest first
+
+  // Runs <interpreter> again with the recorded inputs and compares its events with these ones. The program
+  // and the context must be set up like for the recorded run.
+  // Returns the index of the first differing event (then <expected> and <actual> are set), -1 if none, and
+  // incompleteTrace without running anything if the trace doesn't start with the run
+  int replay(Interpreter &interpreter, Event *expected = 0, Event *actual = 0) const;
+  static const int incompleteTrace = -2;
+
+  bool save(QIODevice *device) const;
+  bool load(QIODevice *device); // Returns false if <device> doesn't hold a trace
+
+private:
+  Q_DISABLE_COPY(ExecutionTrace)
+
+  static const int _chunkCount = 32;
+  static const int _minimumChunkSize = 256; // Room for long inputs
+  static const int _maxVarintSize = 10;
+
+  // Events never straddle two chunks, so dropping the oldest one needs no decoding
+  QVector<uchar> _buffer;
+  uchar *_data; // <_buffer> data, without the detach checks
+  int _chunkSize;
+  int _chunkUsed[_chunkCount]; // Bytes used by the chunks before the current one
+  int _firstChunk; // Oldest
+  int _currentChunk;
+  uchar *_write; // Next byte of the current chunk
+  uchar *_writeEnd;
+  bool _dropped;
+
+  void allocate(int capacity);
+  const uchar *chunkBegin(int chunk) const { return _data + chunk * _chunkSize; }
+  const uchar *chunkEnd(int chunk) const;
+  void nextChunk(); // Forgets the oldest chunk if they are all used
+
+  void appendHeader(EventType type, int value);
+  void appendVarint(quint64 value); // Without checking the room left
+  void append(const uchar *bytes, int count); // Moves to the next chunk if needed
+
+  static int encode(quint64 value, uchar *bytes); // Returns the bytes count
+  static quint64 decode(const uchar *&data, const uchar *end); // <data> is moved after the varint
+  // Returns false if the bytes up to <end> don't start with a valid event
+  static bool readEvent(const uchar *&data, const uchar *end, Event &event);
+
+  // Byte reversed, so that the zero low bits of round numbers give short varints
+  static quint64 numberToBits(double number);
+  static double bitsToNumber(quint64 bits);
+};
+
+inline void ExecutionTrace::appendVarint(quint64 value)
+{
+  while (value >= 0x80)
+  {
+    *_write++ = (uchar) (value | 0x80);
+    value >>= 7;
+  }
+  *_write++ = (uchar) value;
+}
+
+inline void ExecutionTrace::appendHeader(EventType type, int value)
+{
+  // Statements are recorded all the time: most headers take 1 or 2 bytes and fit in the current chunk
+  quint64 header = ((quint64) value << 3) | type;
+  if (header < 0x4000 && _writeEnd - _write >= 2)
+  {
+    if (header >= 0x80)
+    {
+      *_write++ = (uchar) (header | 0x80);
+      header >>= 7;
+    }
+    *_write++ = (uchar) header;
+    return;
+  }
+
+  uchar bytes[_maxVarintSize];
+  append(bytes, encode(header, bytes));
+}
+
+#endif
@@ -1,17 +1,35 @@
 #include <math.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "memory.h"
 
 #include "expression_solver.h"
 
 double ExpressionSolver::solve(const TextLine &expression, int &offset) throw (InterpreterException)
 {
-  QList<int> result;
-  _expression = expression;
+  CompiledExpression compiledExpression = compile(expression, offset);
+
+  // Update offset
+  offset = compiledExpression.endOffset();
+
+  double result;
+  ErrorStatus status;
+  if (!evaluate(compiledExpression, result, status))
+    throw InterpreterException(status);
+  return result;
+}
+
+CompiledExpression ExpressionSolver::compile(const TextLine &expression, int offset) throw (InterpreterException)
+{
+  _expression = &expression;
   _startOffset = offset;
   _currentOffset = _startOffset;
-  _numberStack.clear();
+  _numberCount = 0;
   _commandStack.clear();
+  _compiledExpression = CompiledExpression();
 
   Token token, previousToken;
   while ((token = readToken()).tokenType() != Token::Type_EOF)
@@ -20,6 +38,7 @@ double ExpressionSolver::solve(const TextLine &expression, int &offset) throw (I
 
     if (token.tokenType() == Token::Type_Number ||
         token.isVariable() ||
+        token.isEntity(LCDOp_RanSharp) ||
         token.tokenType() == Token::Type_OpenArrayVar ||
         token.isPreFuncToken() ||
         token.isEntity(LCDChar_OpenParen))
@@ -31,7 +50,7 @@ double ExpressionSolver::solve(const TextLine &expression, int &offset) throw (I
         if (isOperator(_commandStack.top().entity()) || isPreFunc(_commandStack.top().entity()))
         {
           if (comparePriorities(token.entity(), _commandStack.top().entity()) <= 0)
-            performOperation(_commandStack.pop().entity());
+            appendOperation(_commandStack.pop().entity());
         }
       }
 
@@ -45,11 +64,11 @@ double ExpressionSolver::solve(const TextLine &expression, int &offset) throw (I
             isPostFunc(_commandStack.top().entity()))
         {
           if (comparePriorities(token.entity(), _commandStack.top().entity()) <= 0)
-            performOperation(_commandStack.pop().entity());
+            appendOperation(_commandStack.pop().entity());
         }
       }
 
-      performOperation(token.entity());
+      appendOperation(token.entity());
     } else if (token.isEntity(LCDChar_CloseParen))
     {
       // Consume all operators
@@ -64,16 +83,8 @@ double ExpressionSolver::solve(const TextLine &expression, int &offset) throw (I
       // Consume all operators
       performStackOperations(true, false);
       if (!_commandStack.isEmpty() && _commandStack.top().tokenType() == Token::Type_OpenArrayVar)
-      {
-        int entity = _commandStack.pop().entity();
-
-        // Get the stack value, compute the array index and push it
-        int index = (int) _numberStack.pop();
-        bool overflow;
-        _numberStack.push(Memory::instance().variable((LCDChar) entity, index, &overflow));
-        if (overflow)
-          throw InterpreterException(Error_Memory, token.offset());
-      } else // Too much "]" => we stop the analyse and returns on the "]"
+        appendArrayVariable(_commandStack.pop().entity(), token.offset());
+      else // Too much "]" => we stop the analyse and returns on the "]"
       {
         _currentOffset--;
         token = Token();
@@ -89,13 +100,345 @@ double ExpressionSolver::solve(const TextLine &expression, int &offset) throw (I
   // Consume all resting operators
   performStackOperations(true, true);
 
-  // Update offset
-  offset = _currentOffset;
+  // Nothing to return
+  if (!_numberCount)
+    throw InterpreterException(Error_Syntax, _currentToken.offset());
+
+  _compiledExpression.setEndOffset(_currentOffset);
+  return _compiledExpression;
+}
+
+bool ExpressionSolver::evaluate(const CompiledExpression &expression, double &result, ErrorStatus &status)
+{
+  _numberStackCount = 0;
+
+  const QVector<CompiledExpression::Item> &items = expression.items();
+  for (int i = 0; i < items.count(); ++i)
+  {
+    const CompiledExpression::Item &item = items[i];
+    switch (item.type)
+    {
+    case CompiledExpression::Item_Number: pushNumber(item.value); break;
+    case CompiledExpression::Item_Variable:
+      pushNumber(context().memory().variable(item.entity - LCDChar_A));
+      break;
+    case CompiledExpression::Item_Random: pushNumber(context().random()); break;
+    case CompiledExpression::Item_ArrayVariable:
+      {
+        // Get the stack value, compute the array index and push it
+        int index = (int) popNumber();
+        bool overflow;
+        pushNumber(context().memory().variable((LCDChar) item.entity, index, &overflow));
+        if (overflow)
+        {
+          status = ErrorStatus(Error_Memory, item.offset);
+          return false;
+        }
+      }
+      break;
+    case CompiledExpression::Item_Operation:
+      if (!performOperation(item.entity, item.offset, status))
+        return false;
+      break;
+    }
+  }
+
+  result = _numberStack[_numberStackCount - 1];
+  return true;
+}
+
+void ExpressionSolver::evaluateBatch(const CompiledExpression &expression, const QVector<int> &variables,
+                                     const QVector<const double *> &columns, int count, double *results,
+                                     ErrorStatus *errors)
+{
+  bool random = false;
+  foreach (const CompiledExpression::Item &item, expression.items())
+    random = random || item.type == CompiledExpression::Item_Random;
+
+  for (int lane = 0; lane < count; ++lane)
+    errors[lane] = ErrorStatus();
+  for (int first = 0; first < count; first += _batchLanes)
+  {
+    int lanes = qMin(count - first, (int) _batchLanes);
+    if (random)
+      evaluateLanes(expression, variables, columns, first, lanes, results, errors);
+    else
+      evaluateBlock(expression, variables, columns, first, lanes, results, errors);
+  }
+}
+
+static const double *boundColumn(const QVector<int> &variables, const QVector<const double *> &columns, int slot)
+{
+  int index = variables.indexOf(slot);
+  return index >= 0 ? columns[index] : 0;
+}
+
+void ExpressionSolver::evaluateBlock(const CompiledExpression &expression, const QVector<int> &variables,
+                                     const QVector<const double *> &columns, int first, int lanes,
+                                     double *results, ErrorStatus *errors)
+{
+  // A stack of lanes, a failed lane goes on with meaningless values
+  double stack[_numberStackLimit][_batchLanes];
+  int top = -1;
+  errors += first;
+
+  const QVector<CompiledExpression::Item> &items = expression.items();
+  for (int i = 0; i < items.count(); ++i)
+  {
+    const CompiledExpression::Item &item = items[i];
+    switch (item.type)
+    {
+    case CompiledExpression::Item_Number:
+      ++top;
+      for (int lane = 0; lane < lanes; ++lane)
+        stack[top][lane] = item.value;
+      break;
+    case CompiledExpression::Item_Variable:
+      {
+        ++top;
+        const double *column = boundColumn(variables, columns, item.entity - LCDChar_A);
+        double value = column ? 0.0 : context().memory().variable(item.entity - LCDChar_A);
+        for (int lane = 0; lane < lanes; ++lane)
+          stack[top][lane] = column ? column[first + lane] : value;
+      }
+      break;
+    case CompiledExpression::Item_Random: // In the order of evaluate() with one lane, see evaluateLanes()
+      ++top;
+      for (int lane = 0; lane < lanes; ++lane)
+        if (!errors[lane].isError()) // evaluate() stops drawing at the error
+          stack[top][lane] = context().random();
+      break;
+    case CompiledExpression::Item_ArrayVariable:
+      for (int lane = 0; lane < lanes; ++lane)
+      {
+        if (errors[lane].isError()) // The index may be anything
+          continue;
+        int index = (int) stack[top][lane];
+        bool overflow;
+        double value = context().memory().variable((LCDChar) item.entity, index, &overflow);
+        const double *column = boundColumn(variables, columns, item.entity - LCDChar_A + index);
+        if (overflow)
+          errors[lane] = ErrorStatus(Error_Memory, item.offset);
+        else
+          stack[top][lane] = column ? column[first + lane] : value;
+      }
+      break;
+    case CompiledExpression::Item_Operation:
+      {
+        int operands = isOperator(item.entity) ? 2 : 1;
+        top -= operands - 1;
+        if (performLanesOperation(item.entity, item.offset, stack[top], stack[top + 1], lanes, errors))
+          break;
+
+        // Lane by lane
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+          if (errors[lane].isError())
+            continue;
+          _numberStackCount = 0;
+          for (int operand = 0; operand < operands; ++operand)
+            pushNumber(stack[top + operand][lane]);
+          if (performOperation(item.entity, item.offset, errors[lane]))
+            stack[top][lane] = popNumber();
+        }
+      }
+      break;
+    }
+  }
+
+  for (int lane = 0; lane < lanes; ++lane)
+    if (!errors[lane].isError())
+      results[first + lane] = stack[top][lane];
+}
+
+void ExpressionSolver::evaluateLanes(const CompiledExpression &expression, const QVector<int> &variables,
+                                     const QVector<const double *> &columns, int first, int lanes,
+                                     double *results, ErrorStatus *errors)
+{
+  for (int lane = first; lane < first + lanes; ++lane)
+    evaluateBlock(expression, variables, columns, lane, 1, results, errors);
+}
+
+bool ExpressionSolver::performLanesOperation(int entity, int offset, double *d1, const double *d2, int lanes,
+                                             ErrorStatus *errors)
+{
+  // Lanes with a zero divisor or a negative square root get a meaningless value and their error.
+  // The SSE2 operations round like the scalar ones, so the results are the same
+  int lane = 0;
+  switch (entity)
+  {
+  case LCDChar_Add:
+#ifdef __SSE2__
+    for (; lane + 2 <= lanes; lane += 2)
+      _mm_storeu_pd(d1 + lane, _mm_add_pd(_mm_loadu_pd(d1 + lane), _mm_loadu_pd(d2 + lane)));
+#endif
+    for (; lane < lanes; ++lane)
+      d1[lane] = d1[lane] + d2[lane];
+    return true;
+  case LCDChar_Substract:
+#ifdef __SSE2__
+    for (; lane + 2 <= lanes; lane += 2)
+      _mm_storeu_pd(d1 + lane, _mm_sub_pd(_mm_loadu_pd(d1 + lane), _mm_loadu_pd(d2 + lane)));
+#endif
+    for (; lane < lanes; ++lane)
+      d1[lane] = d1[lane] - d2[lane];
+    return true;
+  case LCDChar_Multiply:
+#ifdef __SSE2__
+    for (; lane + 2 <= lanes; lane += 2)
+      _mm_storeu_pd(d1 + lane, _mm_mul_pd(_mm_loadu_pd(d1 + lane), _mm_loadu_pd(d2 + lane)));
+#endif
+    for (; lane < lanes; ++lane)
+      d1[lane] = d1[lane] * d2[lane];
+    return true;
+  case LCDChar_Divide:
+#ifdef __SSE2__
+    for (; lane + 2 <= lanes; lane += 2)
+    {
+      __m128d divisor = _mm_loadu_pd(d2 + lane);
+      int zero = _mm_movemask_pd(_mm_cmpeq_pd(divisor, _mm_setzero_pd()));
+      if ((zero & 1) && !errors[lane].isError())
+        errors[lane] = ErrorStatus(Error_Math, offset);
+      if ((zero & 2) && !errors[lane + 1].isError())
+        errors[lane + 1] = ErrorStatus(Error_Math, offset);
+      _mm_storeu_pd(d1 + lane, _mm_div_pd(_mm_loadu_pd(d1 + lane), divisor));
+    }
+#endif
+    for (; lane < lanes; ++lane)
+    {
+      if (d2[lane] == 0.0 && !errors[lane].isError())
+        errors[lane] = ErrorStatus(Error_Math, offset);
+      d1[lane] = d1[lane] / d2[lane];
+    }
+    return true;
+  case LCDChar_SquareRoot:
+#ifdef __SSE2__
+    for (; lane + 2 <= lanes; lane += 2)
+    {
+      __m128d d = _mm_loadu_pd(d1 + lane);
+      int negative = _mm_movemask_pd(_mm_cmplt_pd(d, _mm_setzero_pd()));
+      if ((negative & 1) && !errors[lane].isError())
+        errors[lane] = ErrorStatus(Error_Math, offset);
+      if ((negative & 2) && !errors[lane + 1].isError())
+        errors[lane + 1] = ErrorStatus(Error_Math, offset);
+      _mm_storeu_pd(d1 + lane, _mm_sqrt_pd(d));
+    }
+#endif
+    for (; lane < lanes; ++lane)
+    {
+      if (d1[lane] < 0.0 && !errors[lane].isError())
+        errors[lane] = ErrorStatus(Error_Math, offset);
+      d1[lane] = sqrt(d1[lane]);
+    }
+    return true;
+  case LCDChar_MinusPrefix:
+    for (; lane < lanes; ++lane)
+      d1[lane] = -d1[lane];
+    return true;
+  case LCDChar_Square:
+    for (; lane < lanes; ++lane)
+      d1[lane] = d1[lane] * d1[lane];
+    return true;
+  default:
+    return false;
+  }
+}
+
+void ExpressionSolver::appendOperation(int entity) throw (InterpreterException)
+{
+  // Operands needed on the number stack
+  int operands = isOperator(entity) ? 2 : 1;
+  if (_numberCount < operands)
+    throw InterpreterException(Error_Syntax, _currentToken.offset());
+  _numberCount -= operands - 1;
+
+  if (!foldOperation(entity, operands, _currentToken.offset()))
+    _compiledExpression.append(CompiledExpression::Item(CompiledExpression::Item_Operation, entity, _currentToken.offset()));
+}
 
-  return _numberStack.top();
+bool ExpressionSolver::foldOperation(int entity, int operands, int offset)
+{
+  const QVector<CompiledExpression::Item> &items = _compiledExpression.items();
+  int count = items.count();
+
+  // Operands which are numbers only: computed now by performOperation(), so the result is the same as at
+  // run time. Not if it fails, the error is raised once reached, nor if it depends on the angle mode,
+  // which the program can change
+  bool numbers = true;
+  for (int i = count - operands; i < count; ++i)
+    numbers = numbers && items[i].type == CompiledExpression::Item_Number;
+  switch (entity)
+  {
+  case LCDOp_Sin: case LCDOp_Cos: case LCDOp_Tan:
+  case LCDChar_DegSuffix: case LCDChar_RadSuffix: case LCDChar_GradSuffix: numbers = false; break;
+  default:;
+  }
+  if (numbers)
+  {
+    _numberStackCount = 0;
+    for (int i = count - operands; i < count; ++i)
+      pushNumber(items[i].value);
+    ErrorStatus status;
+    if (performOperation(entity, offset, status))
+    {
+      CompiledExpression::Item item(CompiledExpression::Item_Number, 0, items[count - operands].offset,
+                                    popNumber());
+      _compiledExpression.remove(count - operands, operands);
+      _compiledExpression.append(item);
+      return true;
+    }
+    return false;
+  }
+
+  // Identities exact for all the doubles, -0.0, infinities and NaNs included: x*1, 1*x, x/1 and x-0.
+  // x+0 isn't one, -0.0+0.0 is 0.0
+  if (operands != 2)
+    return false;
+  const CompiledExpression::Item &right = items[count - 1];
+  if (right.type == CompiledExpression::Item_Number &&
+      ((right.value == 1.0 && (entity == LCDChar_Multiply || entity == LCDChar_Divide)) ||
+       (right.value == 0.0 && !signbit(right.value) && entity == LCDChar_Substract)))
+  {
+    _compiledExpression.remove(count - 1, 1);
+    return true;
+  }
+  int leftEnd = operandStart(count);
+  const CompiledExpression::Item &left = items[leftEnd - 1];
+  if (left.type == CompiledExpression::Item_Number && left.value == 1.0 && entity == LCDChar_Multiply)
+  {
+    _compiledExpression.remove(leftEnd - 1, 1);
+    return true;
+  }
+  return false;
+}
+
+int ExpressionSolver::operandStart(int end) const
+{
+  const QVector<CompiledExpression::Item> &items = _compiledExpression.items();
+  int needed = 1; // Values to push
+  int i = end;
+  while (needed)
+  {
+    const CompiledExpression::Item &item = items[--i];
+    --needed;
+    if (item.type == CompiledExpression::Item_ArrayVariable)
+      ++needed; // Its index
+    else if (item.type == CompiledExpression::Item_Operation)
+      needed += isOperator(item.entity) ? 2 : 1;
+  }
+  return i;
+}
+
+void ExpressionSolver::appendArrayVariable(int entity, int offset) throw (InterpreterException)
+{
+  // Takes the index on the number stack
+  if (!_numberCount)
+    throw InterpreterException(Error_Syntax, offset);
+
+  _compiledExpression.append(CompiledExpression::Item(CompiledExpression::Item_ArrayVariable, entity, offset));
 }
 
-void ExpressionSolver::performOperation(int entity) throw (InterpreterException)
+bool ExpressionSolver::performOperation(int entity, int offset, ErrorStatus &status)
 {
   switch (entity)
   {
@@ -106,21 +449,24 @@ void ExpressionSolver::performOperation(int entity) throw (InterpreterException)
   case LCDOp_Xy:
   case LCDOp_xSquareRoot:
     {
-      double d2 = _numberStack.pop();
-      double d1 = _numberStack.pop();
+      double d2 = popNumber();
+      double d1 = popNumber();
 
       switch (entity)
       {
-      case LCDChar_Multiply: _numberStack.push(d1 * d2); break;
+      case LCDChar_Multiply: pushNumber(d1 * d2); break;
       case LCDChar_Divide:
         if (d2 == 0.0)
-          throw InterpreterException(Error_Math, _currentToken.offset());
-        _numberStack.push(d1 / d2);
+        {
+          status = ErrorStatus(Error_Math, offset);
+          return false;
+        }
+        pushNumber(d1 / d2);
         break;
-      case LCDChar_Add: _numberStack.push(d1 + d2); break;
-      case LCDChar_Substract: _numberStack.push(d1 - d2); break;
-      case LCDOp_Xy: _numberStack.push(pow(d1, d2)); break;
-      case LCDOp_xSquareRoot: _numberStack.push(pow(d2, 1.0 / d1)); break; // NEED a real xSquareRoot function
+      case LCDChar_Add: pushNumber(d1 + d2); break;
+      case LCDChar_Substract: pushNumber(d1 - d2); break;
+      case LCDOp_Xy: pushNumber(pow(d1, d2)); break;
+      case LCDOp_xSquareRoot: pushNumber(pow(d2, 1.0 / d1)); break; // NEED a real xSquareRoot function
       default:;
       }
       break;
@@ -128,33 +474,36 @@ void ExpressionSolver::performOperation(int entity) throw (InterpreterException)
   // Prefixed functions
   case LCDChar_SquareRoot:
     {
-      double d = _numberStack.pop();
+      double d = popNumber();
       if (d < 0.0)
-        throw InterpreterException(Error_Math, _currentToken.offset());
-      _numberStack.push(sqrt(d));
+      {
+        status = ErrorStatus(Error_Math, offset);
+        return false;
+      }
+      pushNumber(sqrt(d));
     }
     break;
-  case LCDOp_CubeSquareRoot: _numberStack.push(cbrt(_numberStack.pop())); break;
-  case LCDOp_Log: _numberStack.push(log10(_numberStack.pop())); break;
-  case LCDChar_Ten: _numberStack.push(pow(10.0, _numberStack.pop())); break;
-  case LCDOp_Ln: _numberStack.push(log(_numberStack.pop())); break;
-  case LCDChar_Euler: _numberStack.push(exp(_numberStack.pop())); break;
-  case LCDOp_Sin: _numberStack.push(sin(native2rad(_numberStack.pop()))); break;
-  case LCDOp_Cos: _numberStack.push(cos(native2rad(_numberStack.pop()))); break;
-  case LCDOp_Tan: _numberStack.push(tan(native2rad(_numberStack.pop()))); break;
-  case LCDOp_Sinh: _numberStack.push(sinh(_numberStack.pop())); break;
-  case LCDOp_Cosh: _numberStack.push(cosh(_numberStack.pop())); break;
-  case LCDOp_Tanh: _numberStack.push(tanh(_numberStack.pop())); break;
-  case LCDOp_Sin_1: _numberStack.push(rad2deg(asin(_numberStack.pop()))); break;
-  case LCDOp_Cos_1: _numberStack.push(rad2deg(acos(_numberStack.pop()))); break;
-  case LCDOp_Tan_1: _numberStack.push(rad2deg(atan(_numberStack.pop()))); break;
-  case LCDOp_Sinh_1: _numberStack.push(asinh(_numberStack.pop())); break;
-  case LCDOp_Cosh_1: _numberStack.push(acosh(_numberStack.pop())); break;
-  case LCDOp_Tanh_1: _numberStack.push(atanh(_numberStack.pop())); break;
-  case LCDChar_MinusPrefix: _numberStack.push(-_numberStack.pop()); break;
-  case LCDOp_Abs: _numberStack.push(fabs(_numberStack.pop())); break;
-  case LCDOp_Int: _numberStack.push((int) _numberStack.pop()); break;
-  case LCDOp_Frac: { double n = _numberStack.pop(); _numberStack.push(n - (double) ((int) n)); } break;
+  case LCDOp_CubeSquareRoot: pushNumber(cbrt(popNumber())); break;
+  case LCDOp_Log: pushNumber(log10(popNumber())); break;
+  case LCDChar_Ten: pushNumber(pow(10.0, popNumber())); break;
+  case LCDOp_Ln: pushNumber(log(popNumber())); break;
+  case LCDChar_Euler: pushNumber(exp(popNumber())); break;
+  case LCDOp_Sin: pushNumber(sin(native2rad(popNumber()))); break;
+  case LCDOp_Cos: pushNumber(cos(native2rad(popNumber()))); break;
+  case LCDOp_Tan: pushNumber(tan(native2rad(popNumber()))); break;
+  case LCDOp_Sinh: pushNumber(sinh(popNumber())); break;
+  case LCDOp_Cosh: pushNumber(cosh(popNumber())); break;
+  case LCDOp_Tanh: pushNumber(tanh(popNumber())); break;
+  case LCDOp_Sin_1: pushNumber(rad2deg(asin(popNumber()))); break;
+  case LCDOp_Cos_1: pushNumber(rad2deg(acos(popNumber()))); break;
+  case LCDOp_Tan_1: pushNumber(rad2deg(atan(popNumber()))); break;
+  case LCDOp_Sinh_1: pushNumber(asinh(popNumber())); break;
+  case LCDOp_Cosh_1: pushNumber(acosh(popNumber())); break;
+  case LCDOp_Tanh_1: pushNumber(atanh(popNumber())); break;
+  case LCDChar_MinusPrefix: pushNumber(-popNumber()); break;
+  case LCDOp_Abs: pushNumber(fabs(popNumber())); break;
+  case LCDOp_Int: pushNumber((int) popNumber()); break;
+  case LCDOp_Frac: { double n = popNumber(); pushNumber(n - (double) ((int) n)); } break;
   case LCDChar_h: break;
   case LCDChar_d: break;
   case LCDChar_b: break;
@@ -162,15 +511,16 @@ void ExpressionSolver::performOperation(int entity) throw (InterpreterException)
   case LCDOp_Neg: break;
   case LCDOp_Not: break;
   // Postfixed functions
-  case LCDChar_Square: { double n = _numberStack.pop(); _numberStack.push(n * n); } break;
-  case LCDChar_MinusOneUp: _numberStack.push(1.0 / _numberStack.pop()); break;
-  case LCDChar_Exclamation: _numberStack.push(factorial(_numberStack.pop())); break;
-  case LCDChar_DegSuffix: _numberStack.push(deg2native(_numberStack.pop())); break;
-  case LCDChar_RadSuffix: _numberStack.push(rad2native(_numberStack.pop())); break;
-  case LCDChar_GradSuffix: _numberStack.push(grad2native(_numberStack.pop())); break;
+  case LCDChar_Square: { double n = popNumber(); pushNumber(n * n); } break;
+  case LCDChar_MinusOneUp: pushNumber(1.0 / popNumber()); break;
+  case LCDChar_Exclamation: pushNumber(factorial(popNumber())); break;
+  case LCDChar_DegSuffix: pushNumber(deg2native(popNumber())); break;
+  case LCDChar_RadSuffix: pushNumber(rad2native(popNumber())); break;
+  case LCDChar_GradSuffix: pushNumber(grad2native(popNumber())); break;
   case LCDChar_Degree: break;
   default:;
   }
+  return true;
 }
 
 void ExpressionSolver::performStackOperations(bool treatOpenParens, bool treatOpenBracket) throw (InterpreterException)
@@ -180,20 +530,11 @@ void ExpressionSolver::performStackOperations(bool treatOpenParens, bool treatOp
     if (_commandStack.top().isOperatorToken() ||
         _commandStack.top().isPreFuncToken() ||
         _commandStack.top().isPostFuncToken())
-      performOperation(_commandStack.pop().entity());
+      appendOperation(_commandStack.pop().entity());
     else if (_commandStack.top().isEntity(LCDChar_OpenParen) && treatOpenParens)
       _commandStack.pop();
     else if (_commandStack.top().tokenType() == Token::Type_OpenArrayVar && treatOpenBracket)
-    {
-      int entity = _commandStack.pop().entity();
-
-      // Get the stack value, compute the array index and push it
-      int index = (int) _numberStack.pop();
-      bool overflow;
-      _numberStack.push(Memory::instance().variable((LCDChar) entity, index, &overflow));
-      if (overflow)
-        throw InterpreterException(Error_Memory, 0); // WARNING
-    }
+      appendArrayVariable(_commandStack.pop().entity(), 0); // WARNING
     else
       break;
   }
@@ -201,35 +542,36 @@ void ExpressionSolver::performStackOperations(bool treatOpenParens, bool treatOp
 
 Token ExpressionSolver::readToken() throw (InterpreterException)
 {
-  if (_currentOffset >= _expression.count())
+  if (_currentOffset >= _expression->count())
   {
-    _currentToken = Token(Token::Type_EOF, _expression.count());
+    _currentToken = Token(Token::Type_EOF, _expression->count());
     return _currentToken;
   }
 
-  int entity = _expression[_currentOffset];
+  int entity = (*_expression)[_currentOffset];
   switch (entity)
   {
   case LCDChar_OpenParen:
   case LCDChar_CloseParen:
-  case LCDChar_CloseBracket: _currentToken = Token(entity, _currentOffset++); break;
+  case LCDChar_CloseBracket:
+  case LCDOp_RanSharp: _currentToken = Token(entity, _currentOffset++); break;
   default:
     if (isOperator(entity) || isPreFunc(entity) || isPostFunc(entity))
       _currentToken = Token(entity, _currentOffset++);
     else if (isAlpha(entity))
     {
       _currentOffset++;
-      if (_currentOffset < _expression.count() && _expression[_currentOffset] == LCDChar_OpenBracket)
+      if (_currentOffset < _expression->count() && (*_expression)[_currentOffset] == LCDChar_OpenBracket)
       {
         Token token(Token::Type_OpenArrayVar, _currentOffset - 1);
-        token.setEntity(_expression[_currentOffset++ - 1]);
+        token.setEntity((*_expression)[_currentOffset++ - 1]);
         _currentToken = token;
       } else
-        _currentToken = Token(_expression[_currentOffset - 1], _currentOffset - 1);
+        _currentToken = Token((*_expression)[_currentOffset - 1], _currentOffset - 1);
     } else if (isCipher(entity) || entity == LCDChar_Dot)
     {
       int firstOffset = _currentOffset;
-      double d = parseNumber(_expression, _currentOffset);
+      double d = parseNumber(*_expression, _currentOffset);
       _currentToken = Token(Token::Type_Number, firstOffset);
       _currentToken.setValue(d);
     } else
@@ -262,10 +604,18 @@ double ExpressionSolver::parseNumber(const TextLine &expression, int &offset) th
 
 void ExpressionSolver::pushToken(const Token &token) throw (InterpreterException)
 {
-  if (token.tokenType() == Token::Type_Number || token.isVariable())
+  if (token.tokenType() == Token::Type_Number || token.isVariable() || token.isEntity(LCDOp_RanSharp))
   {
-    if (_numberStack.count() < _numberStackLimit)
-      _numberStack.push(token.value());
+    if (_numberCount < _numberStackLimit)
+    {
+      if (token.isVariable())
+        _compiledExpression.append(CompiledExpression::Item(CompiledExpression::Item_Variable, token.entity(), token.offset()));
+      else if (token.isEntity(LCDOp_RanSharp))
+        _compiledExpression.append(CompiledExpression::Item(CompiledExpression::Item_Random, token.entity(), token.offset()));
+      else
+        _compiledExpression.append(CompiledExpression::Item(CompiledExpression::Item_Number, 0, token.offset(), token.value()));
+      _numberCount++;
+    }
     else
       throw InterpreterException(Error_Stack, token.offset());
   } else
@@ -294,6 +644,7 @@ void ExpressionSolver::analyzeForSyntaxError(Token token, Token previousToken) t
   }
   else if (previousToken.isPostFuncToken() ||
            previousToken.isEntity(LCDChar_CloseParen) ||
+           previousToken.isEntity(LCDOp_RanSharp) ||
            previousToken.isVariable())
   {
     if (token.tokenType() == Token::Type_Number)
@@ -307,27 +658,28 @@ bool ExpressionSolver::isExpressionStartEntity(int entity)
          isPreFunc(entity) ||
          isCipher(entity) ||
          isAlpha(entity) ||
-         entity == LCDChar_Dot;
+         entity == LCDChar_Dot ||
+         entity == LCDOp_RanSharp;
 }
 
 double ExpressionSolver::numberStackTop(bool &empty)
 {
-  empty = !_numberStack.count();
+  empty = !_numberStackCount;
   if (!empty)
-    return _numberStack.top();
+    return _numberStack[_numberStackCount - 1];
   else
     return 0.0;
 }
 
 void ExpressionSolver::emptyStacks()
 {
-  _numberStack.clear();
+  _numberStackCount = 0;
   _commandStack.clear();
 }
 
 double ExpressionSolver::native2rad(double native) const
 {
-  switch (CalculatorState::instance().angleMode())
+  switch (context().angleMode())
   {
   case Deg: return deg2rad(native);
   case Rad: return native;
@@ -337,7 +689,7 @@ double ExpressionSolver::native2rad(double native) const
 
 double ExpressionSolver::rad2native(double rad) const
 {
-  switch (CalculatorState::instance().angleMode())
+  switch (context().angleMode())
   {
   case Deg: return rad2deg(rad);
   case Rad: return rad;
@@ -347,7 +699,7 @@ double ExpressionSolver::rad2native(double rad) const
 
 double ExpressionSolver::deg2native(double deg) const
 {
-  switch (CalculatorState::instance().angleMode())
+  switch (context().angleMode())
   {
   case Deg: return deg;
   case Rad: return deg2rad(deg);
@@ -357,7 +709,7 @@ double ExpressionSolver::deg2native(double deg) const
 
 double ExpressionSolver::grad2native(double grad) const
 {
-  switch (CalculatorState::instance().angleMode())
+  switch (context().angleMode())
   {
   case Deg: return grad2deg(grad);
   case Rad: return grad2rad(grad);
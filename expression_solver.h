@@ -3,17 +3,34 @@
 
 #include <QStack>
 
+#include "compiled_expression.h"
+#include "emulator_context.h"
 #include "misc.h"
 #include "token.h"
 
 class ExpressionSolver
 {
 public:
-  ExpressionSolver() {}
+  // No context means the default one, looked up when evaluating (compiling doesn't need it)
+  ExpressionSolver(EmulatorContext *context = 0) : _context(context), _expression(0), _numberStackCount(0) {}
+
+  EmulatorContext &context() const { return _context ? *_context : EmulatorContext::defaultContext(); }
+  void setContext(EmulatorContext *context) { _context = context; }
 
   // <offset> is the start offset in <expression> and will be written with the next offset to be read after the expression
   double solve(const TextLine &expression, int &offset) throw (InterpreterException);
 
+  // Translates the expression starting at <offset> into postfix form without solving it
+  CompiledExpression compile(const TextLine &expression, int offset) throw (InterpreterException);
+  // Returns false and sets <status> on error, without throwing
+  bool evaluate(const CompiledExpression &expression, double &result, ErrorStatus &status);
+  // Evaluates <expression> for <count> lanes at once, e.g. for tables and graphs. The variable slots <variables>
+  // (A is 0, A[n] is n) take their values from <columns>, one array of <count> values each, the other variables
+  // are read from the memory. Same results and errors as evaluate() called for each lane:
+  // <results[lane]> is only set if <errors[lane]> isn't an error
+  void evaluateBatch(const CompiledExpression &expression, const QVector<int> &variables,
+                     const QVector<const double *> &columns, int count, double *results, ErrorStatus *errors);
+
   // Returns 0.0 if expression is not a number
   static double parseNumber(const TextLine &expression, int &offset) throw (InterpreterException);
 
@@ -26,12 +43,17 @@ public:
 private:
   static const int _numberStackLimit = 9;
   static const int _commandStackLimit = 20;
-  TextLine _expression;
-  QStack<double> _numberStack;
+  static const int _batchLanes = 64; // Evaluated together by evaluateBatch(), their stacks stay in the L1 cache
+  EmulatorContext *_context; // Memory and modes used by evaluate(), 0 for the default one
+  const TextLine *_expression; // Read by compile(), not copied
+  double _numberStack[_numberStackLimit]; // Compiled expressions never go deeper
+  int _numberStackCount;
   QStack<Token> _commandStack;
   int _startOffset;
   int _currentOffset;
   Token _currentToken;
+  int _numberCount; // Number stack size once compiled items are evaluated
+  CompiledExpression _compiledExpression;
 
   // Returns a token of type Type_EOF if the token is not usable in expression (expression overflow, separator, unknown token
   Token readToken() throw (InterpreterException);
@@ -39,10 +61,30 @@ private:
   void pushToken(const Token &token) throw (InterpreterException);
 
   void performStackOperations(bool treatOpenParens = false, bool treatOpenBracket = false) throw (InterpreterException);
-  void performOperation(int entity) throw (InterpreterException);
+  void appendOperation(int entity) throw (InterpreterException);
+  void appendArrayVariable(int entity, int offset) throw (InterpreterException);
+  bool foldOperation(int entity, int operands, int offset); // Returns true if the operation needs no item
+  int operandStart(int end) const; // Index of the first item of the operand ending before the item <end>
+  bool performOperation(int entity, int offset, ErrorStatus &status); // Returns false on error
+
+  // evaluateBatch() parts, <first> is the first lane of the block
+  void evaluateBlock(const CompiledExpression &expression, const QVector<int> &variables,
+                     const QVector<const double *> &columns, int first, int lanes, double *results,
+                     ErrorStatus *errors);
+  // Blocks of one lane, the Ran# draws must keep the order of evaluate()
+  void evaluateLanes(const CompiledExpression &expression, const QVector<int> &variables,
+                     const QVector<const double *> &columns, int first, int lanes, double *results,
+                     ErrorStatus *errors);
+  // Vectorized operations of performOperation(): <d1> gets the results, <d2> is the second operand of
+  // the operators. Returns false for the other operations
+  static bool performLanesOperation(int entity, int offset, double *d1, const double *d2, int lanes,
+                                    ErrorStatus *errors);
 
   void analyzeForSyntaxError(Token token, Token previousToken) throw (InterpreterException);
 
+  void pushNumber(double value) { _numberStack[_numberStackCount++] = value; }
+  double popNumber() { return _numberStack[--_numberStackCount]; }
+
   double native2rad(double native) const;
   double rad2native(double rad) const;
   double deg2native(double deg) const;
@@ -0,0 +1,12 @@
+# Headless build: the emulator core as a static library, the command line runner and the checks of the core
+TEMPLATE = subdirs
+SUBDIRS = core cli core_check core_check_scalar
+cli.depends = core
+core_check.subdir = check
+core_check.depends = core
+core_check_scalar.subdir = check_scalar
+
+# make check builds and runs the checks
+check.CONFIG = recursive
+check.recurse = core_check core_check_scalar
+QMAKE_EXTRA_TARGETS += check
@@ -0,0 +1,28 @@
+#include "input_provider.h"
+
+QueueInputProvider::QueueInputProvider(const QList<TextLine> &inputs)
+{
+  foreach (const TextLine &value, inputs)
+    _inputs.enqueue(value);
+}
+
+bool QueueInputProvider::input(TextLine &value)
+{
+  if (_inputs.isEmpty())
+    return false;
+  value = _inputs.dequeue();
+  return true;
+}
+
+StreamInputProvider::StreamInputProvider(QIODevice *device) :
+  _stream(device)
+{
+}
+
+bool StreamInputProvider::input(TextLine &value)
+{
+  if (_stream.atEnd())
+    return false;
+  value.assignString(_stream.readLine());
+  return true;
+}
@@ -0,0 +1,71 @@
+#ifndef INPUT_PROVIDER_H
+#define INPUT_PROVIDER_H
+
+#include <QQueue>
+#include <QTextStream>
+
+#include "misc.h"
+
+class QIODevice;
+
+// Source of the user answers, called from the interpreter thread.
+// Without provider, the interpreter waits for sendInput() and sendValidation().
+class InputProvider
+{
+public:
+  virtual ~InputProvider() {}
+
+  // Answer to a "?" prompt. Returns false if there is none, the program then gets an empty input
+  virtual bool input(TextLine &value) = 0;
+
+  // Called on a "- Disp -" pause, the program goes on when it returns
+  virtual void validate() {}
+};
+
+// Pre-supplied answers
+class QueueInputProvider : public InputProvider
+{
+public:
+  QueueInputProvider(const QList<TextLine> &inputs = QList<TextLine>());
+
+  void append(const TextLine &value) { _inputs.enqueue(value); }
+  int count() const { return _inputs.count(); }
+
+  bool input(TextLine &value);
+
+private:
+  QQueue<TextLine> _inputs;
+};
+
+// Answers given by a function
+class CallbackInputProvider : public InputProvider
+{
+public:
+  typedef bool (*InputCallback)(TextLine &value, void *data);
+  typedef void (*ValidateCallback)(void *data);
+
+  CallbackInputProvider(InputCallback inputCallback, ValidateCallback validateCallback = 0, void *data = 0) :
+    _inputCallback(inputCallback), _validateCallback(validateCallback), _data(data) {}
+
+  bool input(TextLine &value) { return _inputCallback(value, _data); }
+  void validate() { if (_validateCallback) _validateCallback(_data); }
+
+private:
+  InputCallback _inputCallback;
+  ValidateCallback _validateCallback;
+  void *_data;
+};
+
+// One answer per line of a file or of stdin, special entities written as {id}
+class StreamInputProvider : public InputProvider
+{
+public:
+  StreamInputProvider(QIODevice *device);
+
+  bool input(TextLine &value);
+
+private:
+  QTextStream _stream;
+};
+
+#endif
@@ -4,254 +4,607 @@
 
 #include "interpreter.h"
 
-Interpreter::Interpreter(const QList<TextLine> &program) :
+Interpreter::Interpreter(const QList<TextLine> &program, EmulatorContext &context) :
+  _quiet(false),
+  _screenLineEnd(0),
+  _screenLineTotal(0),
   _currentProgramIndex(-1),
-  _currentOffset(0),
+  _code(&_compiledProgram),
+  _currentInstruction(0),
+  _status(Status_Finished),
+  _suspendedInstruction(0),
+  _context(&context),
+  _expressionSolver(&context),
   _error(false),
+  _lastError(Error_No),
   _errorStep(0),
   _lastResult(0.0),
-  _waitForInput(false),
-  _waitForValidation(false),
-  _displayDefm(false)
+  _waitState(Wait_None),
+  _inputProvider(0),
+  _displayDefm(false),
+  _displayLastNumber(true),
+  _profiler(0),
+  _trace(0),
+  _history(0),
+  _stepBudget(0),
+  _deadline(0),
+  _stopStep(-1),
+  _seekInputCount(-1),
+  _stopReason(Stop_Seek),
+  _stopVariable(-1),
+  _breakpointCount(0),
+  _singleStep(false),
+  _debugSkip(false),
+  _nextCheck(-1),
+  _executedSteps(0)
 {
   setProgram(program);
 }
 
+Interpreter::~Interpreter()
+{
+  stopWorker();
+}
+
+bool Interpreter::submit(const QList<TextLine> &program)
+{
+  // A program waiting for the worker must run first. A stop of the debugging would wait in the calling thread
+  Job job(program, _lastJobId.fetchAndAddOrdered(1) + 1); // A failed push only skips an id
+  if (!_pendingJobs && !isDebugging() && canRunInline(program))
+  {
+    _pendingJobs.ref();
+    runJob(job, true);
+    return true;
+  }
+
+  if (!isRunning())
+    start();
+  _pendingJobs.ref();
+  if (_jobs.tryPush(job))
+    return true;
+  _pendingJobs.deref();
+  return false;
+}
+
 void Interpreter::run()
+{
+  Job job;
+  while (_jobs.pop(job))
+    runJob(job, false);
+}
+
+void Interpreter::runJob(const Job &job, bool inlined)
+{
+  // Not the flag alone: a cancel() after the end of the previous run may have left it set, and the end of
+  // that run may have cleared the one of a cancel() given while this job was waiting
+  _cancelRequested = job.id <= _cancelledJobId ? 1 : 0;
+  setProgram(job.program);
+
+  // The calling thread of an inline run is the GUI one: the real hardware pacing would freeze it, and a few
+  // statements are instantaneous to the user anyway. Restored before the signal, whose slots may submit again
+  bool unthrottled = inlined && _speedGovernor.mode() == SpeedGovernor::Mode_RealHardware;
+  if (unthrottled)
+    _speedGovernor.setMode(SpeedGovernor::Mode_Unthrottled);
+  interpret();
+  if (unthrottled)
+    _speedGovernor.setMode(SpeedGovernor::Mode_RealHardware);
+  finishJob();
+}
+
+void Interpreter::finishJob()
+{
+  _pendingJobs.deref(); // Before the signal, so its slots can submit again
+  emit jobFinished();
+}
+
+void Interpreter::stopWorker()
+{
+  if (!isRunning())
+    return;
+
+  cancel();
+  _jobs.interrupt();
+  wait();
+  _jobs.reset();
+  _pendingJobs = 0;
+}
+
+bool Interpreter::canRunInline(const QList<TextLine> &program)
+{
+  int statements = program.count(); // At least one per line
+  foreach (const TextLine &line, program)
+    foreach (int entity, line)
+    {
+      switch (entity)
+      {
+      case LCDChar_Question:
+      case LCDChar_RBTriangle:
+      case LCDOp_Goto:
+      case LCDOp_Prog:
+        return false;
+      default:
+        if (isSeparator(entity))
+          ++statements;
+      }
+    }
+  return statements <= _inlineStatementLimit;
+}
+
+void Interpreter::interpret()
+{
+  _answers.reset();
+  Status status = execute();
+  while (status != Status_Finished)
+  {
+    TextLine answer;
+    if (status == Status_Stopped && _inputProvider)
+      _inputProvider->validate(); // Like a pause
+    else
+      waitForAnswer(status, answer);
+    status = resume(answer); // Breaks the run if cancelled
+  }
+  _cancelRequested = 0; // Only now, a cancel() before a direct call must break it. runJob() sets it for a job
+}
+
+Interpreter::Status Interpreter::execute()
 {
   _error = false;
-  try
+  _lastError = Error_No;
+  _speedGovernor.reset();
+  _executedSteps = 0;
+  _runTimer.start();
+  _screenLineEnd = 0;
+  _screenLineTotal = 0;
+  if (_trace)
+    _trace->clear();
+  if (_history)
+    _history->clear();
+  _seekInputCount = -1;
+  _debugSkip = false;
+  setCurrentProgram(-1);
+  _currentInstruction = 0;
+  _callStack.clear();
+  _displayDefm = false;
+  _displayLastNumber = true;
+  return continueExecution();
+}
+
+Interpreter::Status Interpreter::resume(const TextLine &value)
+{
+  if (_status == Status_Finished)
+    return _status;
+
+  if (_history && _seekInputCount >= 0) // The run goes on differently from there
+    _history->truncate(_executedSteps, _seekInputCount);
+  _seekInputCount = -1;
+  _debugSkip = _status == Status_Stopped;
+
+  const CompiledProgram::Instruction &instruction = compiledProgram().at(_suspendedInstruction);
+  _runError = ErrorStatus();
+  if (_cancelRequested)
+    fail(Error_Break, instruction.offset);
+  else if (_status == Status_NeedsInput)
   {
-    execute();
-  } catch (InterpreterException exception)
+    _input = value;
+    if (_trace)
+      _trace->input(_input);
+    if (_history)
+      _history->input(_input);
+    storeInput(instruction);
+  }
+
+  if (_runError.isError())
+  {
+    finishExecution();
+    return _status;
+  }
+  return continueExecution();
+}
+
+Interpreter::Status Interpreter::continueExecution()
+{
+  _runError = ErrorStatus();
+  _nextCheck = -1; // The limits may have changed
+
+  bool debugging = _stopStep < 0 && isDebugging(); // Not while seeking
+  if (debugging)
+  {
+    for (int i = 0; i < _watchpoints.count(); ++i)
+      _watchValues[i] = _context->memory().variable(_watchpoints[i]);
+    _status = executeInstructions<true>();
+  } else
+    _status = executeInstructions<false>();
+  if (_status == Status_Finished)
+    finishExecution();
+
+  // The statement a run is suspended on or failed in isn't complete, a pause isn't a statement
+  if (_history)
+    _history->setEnd(_status == Status_Stopped || _status == Status_NeedsValidation ||
+                     (_status == Status_Finished && !_error) ? _executedSteps : _executedSteps - 1);
+  return _status;
+}
+
+bool Interpreter::seek(qint64 step)
+{
+  int index = _history ? _history->checkpointBefore(step) : -1;
+  if (index < 0 || step > _history->end())
+    return false;
+
+  const ExecutionHistory::Checkpoint &checkpoint = _history->checkpointAt(index);
+  setCurrentProgram(checkpoint.program);
+  _currentInstruction = checkpoint.instruction;
+  _callStack.clear();
+  for (int i = 0; i < checkpoint.callStack.count(); i += 2)
+    _callStack.push(ProgramIndex(checkpoint.callStack[i], checkpoint.callStack[i + 1]));
+  _lastResult = checkpoint.lastResult;
+  _displayLastNumber = checkpoint.displayLastNumber;
+  _displayDefm = checkpoint.displayDefm;
+  _context->setAngleMode(checkpoint.angleMode);
+  _context->setRandomSeed(checkpoint.randomState);
+  _history->restoreVariables(index, _context->memory());
+  _executedSteps = checkpoint.step;
+  _error = false;
+  _lastError = Error_No;
+  _cancelRequested = 0;
+
+  // Interpret again up to <step>, without recording anything
+  ExecutionHistory *history = _history;
+  ExecutionTrace *trace = _trace;
+  ExecutionProfiler *profiler = _profiler;
+  InputProvider *inputProvider = _inputProvider;
+  bool quiet = _quiet;
+  qint64 stepBudget = _stepBudget;
+  qint64 deadline = _deadline;
+  QueueInputProvider provider(history->inputs(checkpoint.inputCount));
+  int inputCount = checkpoint.inputCount + provider.count();
+  _history = 0;
+  _trace = 0;
+  _profiler = 0;
+  _inputProvider = &provider;
+  _quiet = true;
+  _stepBudget = 0;
+  _deadline = 0;
+  _stopStep = step;
+  continueExecution();
+  _history = history;
+  _trace = trace;
+  _profiler = profiler;
+  _inputProvider = inputProvider;
+  _quiet = quiet;
+  _stepBudget = stepBudget;
+  _deadline = deadline;
+  _stopStep = -1;
+
+  _seekInputCount = inputCount - provider.count();
+  return true;
+}
+
+int Interpreter::currentOffset() const
+{
+  if (_status == Status_Finished)
+    return -1;
+  return compiledProgram().at(_suspendedInstruction).offset;
+}
+
+void Interpreter::finishExecution()
+{
+  _status = Status_Finished;
+  if (_profiler)
+    _profiler->stop();
+
+  if (_runError.isError())
   {
     _error = true;
-    _errorStep = exception.offset();
-    display(errorLines(exception.error(), _errorStep));
+    _lastError = _runError.error();
+    _errorStep = _runError.offset();
+    display(errorLines(_lastError, _errorStep));
   }
 }
 
-void Interpreter::execute() throw (InterpreterException)
+template <bool debug> Interpreter::Status Interpreter::executeInstructions()
 {
-  int entity;
-  _displayDefm = false;
-  bool displayLastNumber = true;
-  while ((entity = currentEntity()) != -1)
+  const CompiledProgram *code = _code;
+  while (true)
   {
-    msleep(10);
-    displayLastNumber = true;
-    _displayDefm = false;
-    switch (entity)
+    const CompiledProgram::Instruction &instruction = code->at(_currentInstruction++);
+    if (instruction.op == CompiledProgram::Op_End)
     {
-    case LCDChar_DoubleQuote: // A string instruction?
+      // Is there any program in callstack?
+      if (!_callStack.count())
+        break;
+
+      ProgramIndex progIndex = _callStack.pop();
+      setCurrentProgram(progIndex.program);
+      _currentInstruction = progIndex.step;
+      if (_trace)
+        _trace->program(_currentProgramIndex);
+      code = _code;
+      continue;
+    } else if (instruction.op == CompiledProgram::Op_Pause)
+    {
+      if (pause())
       {
-        TextLine textLine = parseString();
-        if (currentEntity() == LCDChar_Question)
-          parseInput(textLine);
-        else
-        {
-          storeDisplayLine(textLine);
-          emit displayLine();
-          displayLastNumber = false;
-        }
+        _suspendedInstruction = _currentInstruction - 1;
+        return Status_NeedsValidation;
       }
+      continue;
+    }
+
+    // Program ends and pauses aren't statements: not counted, traced nor stopped at
+    ++_executedSteps;
+    if (((_executedSteps > _nextCheck || _cancelRequested) && !checkStatement(instruction.offset)) ||
+        (debug && !checkDebug(instruction.offset)))
+    {
+      if (_runError.isError())
+        return Status_Finished;
+      _suspendedInstruction = --_currentInstruction;
+      --_executedSteps;
+      return Status_Stopped;
+    }
+    if (_trace)
+      _trace->statement(instruction.offset);
+    if (_profiler)
+      _profiler->statement(_currentProgramIndex, instruction);
+    _speedGovernor.statement(instruction.entity);
+    _displayLastNumber = true;
+    _displayDefm = false;
+    switch (instruction.op)
+    {
+    case CompiledProgram::Op_Display:
+      display(code->strings(instruction.operand));
+      _displayLastNumber = false;
       break;
-    case LCDChar_Question: // An input affectation?
-      parseInput();
+    case CompiledProgram::Op_Input:
+      display(code->strings(instruction.operand));
+      if (!_inputProvider) // Wait for user data
+      {
+        _suspendedInstruction = _currentInstruction - 1;
+        return Status_NeedsInput;
+      }
+      if (!_inputProvider->input(_input))
+        _input.clear(); // Like validating an empty input
+      if (_trace)
+        _trace->input(_input);
+      if (_history)
+        _history->input(_input);
+      if (!storeInput(instruction))
+        return Status_Finished;
       break;
-    case LCDOp_Lbl: parseLabel(); break;
-    case LCDOp_Goto: parseGoto(); break;
-    case LCDOp_Deg: case LCDOp_Rad: case LCDOp_Gra: changeAngleMode(entity); break;
-    case LCDOp_Prog: if (parseProg()) continue; else break;
-    case LCDOp_Defm: parseDefm(); _displayDefm = true; displayLastNumber = false; break;
-    default:
-      if (ExpressionSolver::isExpressionStartEntity(entity))
+    case CompiledProgram::Op_Expression:
       {
-        double d = _expressionSolver.solve(program(), _currentOffset);
+        double d;
+        if (!_expressionSolver.evaluate(code->expression(instruction.expression), d, _runError))
+          return Status_Finished;
         _lastResult = d;
-        if (eatEntity(LCDChar_Arrow)) // Affectation?
-          parseVariableAndStore(d);
-        else if (isComparisonOperator(currentEntity()))
-        {
-          int comp = readEntity();
-          double d2 = _expressionSolver.solve(program(), _currentOffset);
-          _lastResult = d2;
-
-          // "=>" is expected
-          if (!eatEntity(LCDChar_DoubleArrow))
-            throw InterpreterException(Error_Syntax, _currentOffset);
-
-          // Some non sep char is expected
-          if (isSeparator(currentEntity()) || currentEntity() == -1)
-            throw InterpreterException(Error_Syntax, _currentOffset);
-
-          // compute boolean
-          if (!computeBoolean(comp, d, d2))
-            moveOffsetToNextInstruction();
-          continue;
-        }
+        if (instruction.variable >= 0 && !store(instruction, d)) // Affectation?
+          return Status_Finished;
       }
-    }
-    // Separator is mandatory
-    if (isSeparator(currentEntity()) || currentEntity() == -1)
-    {
-      int sep = readEntity();
-
-      if (sep == LCDChar_RBTriangle)
+      break;
+    case CompiledProgram::Op_Condition:
       {
-        if (displayLastNumber)
-        {
-          TextLine textLine = formatDouble(_lastResult);
-          textLine.setRightJustified(true);
-          storeDisplayLine(textLine);
-          emit displayLine();
-        }
+        double d, d2;
+        if (!_expressionSolver.evaluate(code->expression(instruction.expression), d, _runError))
+          return Status_Finished;
+        _lastResult = d;
+        if (!_expressionSolver.evaluate(code->expression(instruction.expression2), d2, _runError))
+          return Status_Finished;
+        _lastResult = d2;
 
-        // Wait for user data
-        _waitForValidation = true;
-        _inputMutex.lock();
-        emit askForValidation();
-        _inputWaitCondition.wait(&_inputMutex);
-        _inputMutex.unlock();
+        // compute boolean
+        if (!computeBoolean(instruction.comparison, d, d2))
+          _currentInstruction = instruction.jump;
       }
-
-      // Is there any program in callstack?
-      if (currentEntity() == -1 && _callStack.count())
+      break;
+    case CompiledProgram::Op_Goto:
+      _currentInstruction = instruction.jump;
+      if (_trace)
+        _trace->jump(_currentInstruction);
+      break;
+    case CompiledProgram::Op_Prog:
+      if (callProg(instruction.operand))
       {
-        ProgramIndex progIndex = _callStack.pop();
-        _currentProgramIndex = progIndex.program;
-        _currentOffset = progIndex.step;
+        code = _code;
+        if (_trace)
+          _trace->program(_currentProgramIndex);
       }
-    } else
-      throw InterpreterException(Error_Syntax, _currentOffset);
+      break;
+    case CompiledProgram::Op_AngleMode: changeAngleMode(instruction.operand); break;
+    case CompiledProgram::Op_Defm:
+      if (!defm(instruction))
+        return Status_Finished;
+      _displayDefm = true;
+      _displayLastNumber = false;
+      break;
+    case CompiledProgram::Op_Dsz:
+    case CompiledProgram::Op_Isz:
+      {
+        bool zero;
+        if (!stepCounter(instruction, zero))
+          return Status_Finished;
+        if (!zero)
+          break;
+
+        // Skip the next statement, after the pause ending the Dsz/Isz statement if any
+        int pauseInstruction = _currentInstruction;
+        _currentInstruction = instruction.jump;
+        if (code->at(pauseInstruction).op == CompiledProgram::Op_Pause && pause())
+        {
+          _suspendedInstruction = pauseInstruction;
+          return Status_NeedsValidation;
+        }
+      }
+      break;
+    case CompiledProgram::Op_Error: fail((Error) instruction.operand, instruction.errorOffset); return Status_Finished;
+    default:;
+    }
   }
 
   // Display the stack value?
-  if (displayLastNumber)
+  if (_displayLastNumber)
+    displayLastResult();
+  return Status_Finished;
+}
+
+bool Interpreter::checkStatement(int offset)
+{
+  if (_cancelRequested ||
+      (_stepBudget > 0 && _executedSteps > _stepBudget) ||
+      (_deadline > 0 && !(_executedSteps & 0xff) && _runTimer.elapsed() >= _deadline)) // The timer is slower than a statement
+    return fail(Error_Break, offset);
+
+  qint64 step = _executedSteps - 1; // Before the statement
+  if (_stopStep >= 0 && step >= _stopStep)
   {
-    TextLine textLine = formatDouble(_lastResult);
-    textLine.setRightJustified(true);
-    storeDisplayLine(textLine);
-    emit displayLine();
+    _stopReason = Stop_Seek;
+    _stopStep = -1; // resume() goes on
+    return false;
   }
+  if (_history && step >= _history->nextCheckpoint())
+    takeCheckpoint();
+
+  // Nothing to check before the next limit
+  _nextCheck = Q_INT64_C(0x7fffffffffffffff);
+  if (_stepBudget > 0)
+    _nextCheck = _stepBudget;
+  if (_deadline > 0)
+    _nextCheck = qMin(_nextCheck, _executedSteps | 0xff);
+  if (_stopStep >= 0)
+    _nextCheck = qMin(_nextCheck, _stopStep);
+  if (_history)
+    _nextCheck = qMin(_nextCheck, _history->nextCheckpoint());
+  return true;
 }
 
-int Interpreter::readEntity()
+bool Interpreter::checkDebug(int offset)
 {
-  if (_currentProgramIndex >= 0)
+  // The previous statement may have changed a watched variable
+  for (int i = 0; i < _watchpoints.count(); ++i)
   {
-    Program *program = Memory::instance().programAt(_currentProgramIndex);
-    if (_currentOffset >= program->count())
-      return -1;
-    else
-      return program->entityAt(_currentOffset++);
+    double value = _context->memory().variable(_watchpoints[i]);
+    if (value != _watchValues[i])
+    {
+      _watchValues[i] = value;
+      _stopReason = Stop_Watchpoint;
+      _stopVariable = _watchpoints[i];
+      return false;
+    }
   }
 
-  // Internal program
-  if (_currentOffset >= _program.count())
-    return -1;
+  if (_debugSkip)
+  {
+    _debugSkip = false;
+    return true;
+  }
+  if (_singleStep)
+  {
+    _stopReason = Stop_Step;
+    return false;
+  }
+  if (_breakpoints[_currentProgramIndex + 1].contains(offset))
+  {
+    _stopReason = Stop_Breakpoint;
+    return false;
+  }
+  return true;
+}
 
-  return _program[_currentOffset++];
+void Interpreter::setBreakpoint(int program, int offset, bool enabled)
+{
+  QSet<int> &breakpoints = _breakpoints[program + 1];
+  _breakpointCount -= breakpoints.count();
+  if (enabled)
+    breakpoints.insert(statementOffset(program, offset));
+  else
+    breakpoints.remove(statementOffset(program, offset));
+  _breakpointCount += breakpoints.count();
 }
 
-int Interpreter::currentEntity() const
+bool Interpreter::hasBreakpoint(int program, int offset) const
 {
-  if (_currentProgramIndex >= 0)
-  {
-    Program *program = Memory::instance().programAt(_currentProgramIndex);
-    if (_currentOffset >= program->count())
-      return -1;
-    else
-      return program->entityAt(_currentOffset);
-  }
+  return _breakpoints[program + 1].contains(statementOffset(program, offset));
+}
 
-  // Internal program
-  if (_currentOffset >= _program.count())
-    return -1;
+int Interpreter::statementOffset(int program, int offset) const
+{
+  const CompiledProgram &code = program >= 0 ? _context->memory().programAt(program)->compiledProgram() :
+                                               _compiledProgram;
+  int result = 0;
+  for (int i = 0; i < code.count(); ++i)
+    if (code.at(i).offset <= offset)
+      result = qMax(result, code.at(i).offset);
+  return result;
+}
 
-  return _program[_currentOffset];
+void Interpreter::clearBreakpoints()
+{
+  for (int i = 0; i <= Memory::programsCount; ++i)
+    _breakpoints[i].clear();
+  _breakpointCount = 0;
 }
 
-int Interpreter::entityAt(int index) const
+void Interpreter::setWatchpoint(int variable, bool enabled)
 {
-  if (_currentProgramIndex >= 0)
+  int index = _watchpoints.indexOf(variable);
+  if (enabled && index < 0)
   {
-    Program *program = Memory::instance().programAt(_currentProgramIndex);
-    if (index >= program->count())
-      return -1;
-    else
-      return program->entityAt(index);
+    _watchpoints << variable;
+    _watchValues << 0.0;
+  } else if (!enabled && index >= 0)
+  {
+    _watchpoints.remove(index);
+    _watchValues.remove(index);
   }
+}
 
-  // Internal program
-  if (index < 0 || index >= _program.count())
-    return -1;
-
-  return _program[index];
+void Interpreter::clearWatchpoints()
+{
+  _watchpoints.clear();
+  _watchValues.clear();
 }
 
-bool Interpreter::eatEntity(int entity)
+void Interpreter::takeCheckpoint()
 {
-  if (currentEntity() == entity)
-  {
-    readEntity();
-    return true;
-  } else
-    return false;
+  ExecutionHistory::Checkpoint checkpoint;
+  checkpoint.step = _executedSteps - 1;
+  checkpoint.program = _currentProgramIndex;
+  checkpoint.instruction = _currentInstruction - 1;
+  foreach (const ProgramIndex &programIndex, _callStack)
+    checkpoint.callStack << programIndex.program << programIndex.step;
+  checkpoint.lastResult = _lastResult;
+  checkpoint.displayLastNumber = _displayLastNumber;
+  checkpoint.displayDefm = _displayDefm;
+  checkpoint.angleMode = _context->angleMode();
+  checkpoint.randomState = _context->randomState();
+  _history->checkpoint(checkpoint, _context->memory());
 }
 
-int Interpreter::readAlpha() throw(InterpreterException)
+bool Interpreter::fail(Error error, int offset)
 {
-  if (isAlpha(currentEntity()))
-    return readEntity();
-  else
-    throw InterpreterException(Error_Syntax, _currentOffset);
+  _runError = ErrorStatus(error, offset);
+  return false;
 }
 
-int Interpreter::indexOfEntity(int entity, int from) const
+void Interpreter::cancel()
 {
-  if (_currentProgramIndex >= 0)
-    return Memory::instance().programAt(_currentProgramIndex)->indexOf(entity, from);
-  else
-    return _program.indexOf(entity, from);
+  _cancelledJobId.fetchAndStoreOrdered(_lastJobId);
+  _cancelRequested = 1;
+  _answers.interrupt();
 }
 
-const TextLine &Interpreter::program() const
+void Interpreter::setCurrentProgram(int index)
 {
-  if (_currentProgramIndex >= 0)
-    return Memory::instance().programAt(_currentProgramIndex)->rawSteps();
-  else
-    return _program;
+  _currentProgramIndex = index;
+  _code = index >= 0 ? &_context->memory().programAt(index)->compiledProgram() : &_compiledProgram;
 }
 
 void Interpreter::setProgram(const QList<TextLine> &program)
 {
   _program.affect(program);
-  _currentOffset = 0;
+  _compiledProgram.compile(_program);
+  setCurrentProgram(-1);
+  _currentInstruction = 0;
   _callStack.clear();
-}
-
-TextLine Interpreter::parseString()
-{
-  TextLine textLine;
-  int entity;
-  readEntity(); // Pass the "
-  while ((entity = currentEntity()) != -1)
-  {
-    if (eatEntity(LCDChar_DoubleQuote))
-      break;
-    else if (entity == LCDChar_CR || entity == LCDChar_RBTriangle)
-    {
-      storeDisplayLine(textLine);
-      emit displayLine();
-      textLine.clear();
-    } else
-      textLine << entity;
-    readEntity(); // Pass the current entity
-  }
-  if (entity == -1)
-    throw InterpreterException(Error_Syntax, 0); // TODO: good line & offset
-  return textLine;
+  _status = Status_Finished; // A suspended run is dropped
 }
 
 bool Interpreter::computeBoolean(int comp, double d1, double d2)
@@ -268,102 +621,105 @@ bool Interpreter::computeBoolean(int comp, double d1, double d2)
   }
 }
 
-void Interpreter::moveOffsetToNextInstruction()
+bool Interpreter::pause()
 {
-  // Get after the next separator
-  int entity;
-  while ((entity = currentEntity()) != -1)
+  if (_displayLastNumber)
+    displayLastResult();
+
+  if (_inputProvider)
   {
-    if (isSeparator(entity))
-      break;
-    readEntity(); // Pass the current entity
+    _inputProvider->validate();
+    return false;
   }
+  return true;
 }
 
-void Interpreter::parseLabel()
+void Interpreter::waitForAnswer(Status status, TextLine &answer)
 {
-  readEntity(); // Pass the "label "
-  if (!isCipher(currentEntity()))
-    throw InterpreterException(Error_Argument, _currentOffset);
-  readEntity(); // Pass the cipher
-  if (!isSeparator(currentEntity()) && currentEntity() != -1)
-    throw InterpreterException(Error_Argument, _currentOffset);
+  _waitState.fetchAndStoreOrdered(status == Status_NeedsInput ? Wait_Input : Wait_Validation);
+  switch (status)
+  {
+  case Status_NeedsInput: emit askForInput(); break;
+  case Status_Stopped: emit stopped(); break;
+  default: emit askForValidation();
+  }
+
+  _answers.pop(answer);
+  _waitState.fetchAndStoreOrdered(Wait_None); // Only useful if cancelled
 }
 
-void Interpreter::parseGoto()
+QList<TextLine> Interpreter::takeDisplayLines()
 {
-  readEntity(); // Pass the "goto "
-  if (!isCipher(currentEntity()))
-    throw InterpreterException(Error_Argument, _currentOffset);
-  int cipher = readEntity(); // Pass the cipher
-  if (!isSeparator(currentEntity()) && currentEntity() != -1)
-    throw InterpreterException(Error_Argument, _currentOffset);
+  _displayPending.fetchAndStoreOrdered(0); // Lines stored from now are signalled again
+
+  QList<TextLine> lines;
+  TextLine textLine;
+  while (_displayLines.tryPop(textLine))
+    lines << textLine;
+  return lines;
+}
 
-  int p = 0;
-  while ((p = indexOfEntity(LCDOp_Lbl, p)) >= 0)
+QList<TextLine> Interpreter::screenLines() const
+{
+  QList<TextLine> lines;
+  int count = qMin(_screenLineTotal, (int) screenLineCount);
+  for (int i = count; i > 0; --i)
   {
-    if (entityAt(p + 1) == cipher &&
-        (p == 0 || isSeparator(entityAt(p - 1))) &&
-        (entityAt(p + 1) == -1 || isSeparator(entityAt(p + 2))))
+    const ScreenLine &screenLine = _screenLines[(_screenLineEnd - i + screenLineCount) % screenLineCount];
+    if (screenLine.isNumber)
     {
-      _currentOffset = p + 2;
-      return;
-    }
-    p++;
+      TextLine textLine = formatDouble(screenLine.number);
+      textLine.setRightJustified(true);
+      lines << textLine;
+    } else
+      lines << screenLine.textLine;
   }
-  throw InterpreterException(Error_Goto, _currentOffset);
+  return lines;
 }
 
-TextLine Interpreter::getNextDisplayLine()
+Interpreter::ScreenLine &Interpreter::nextScreenLine()
 {
-  QMutexLocker loker(&_displayLineMutex);
-
-  if (_displayLines.count())
-    return _displayLines.dequeue();
-  else
-    return TextLine();
+  ScreenLine &screenLine = _screenLines[_screenLineEnd];
+  _screenLineEnd = (_screenLineEnd + 1) % screenLineCount;
+  ++_screenLineTotal;
+  return screenLine;
 }
 
 void Interpreter::storeDisplayLine(const TextLine &textLine)
 {
-  QMutexLocker loker(&_displayLineMutex);
+  if (_quiet)
+  {
+    ScreenLine &screenLine = nextScreenLine();
+    screenLine.isNumber = false;
+    screenLine.textLine = textLine;
+    return;
+  }
+
+  _displayLines.push(textLine);
 
-  _displayLines.enqueue(textLine);
+  // Only the first waiting line is signalled
+  if (_displayPending.testAndSetOrdered(0, 1))
+    emit displayLine();
 }
 
 void Interpreter::sendInput(const TextLine &value)
 {
-  if (!_waitForInput)
-    return;
-
-  _input = value;
-  _waitForInput = false;
-  _inputWaitCondition.wakeAll();
+  // The interpreter must be waiting, and only the first answer counts
+  if (_waitState.testAndSetOrdered(Wait_Input, Wait_None))
+    _answers.tryPush(value);
 }
 
 void Interpreter::sendValidation()
 {
-  if (!_waitForValidation)
-    return;
-
-  _waitForValidation = false;
-  _inputWaitCondition.wakeAll();
+  if (_waitState.testAndSetOrdered(Wait_Validation, Wait_None))
+    _answers.tryPush(TextLine());
 }
 
 QList<TextLine> Interpreter::errorLines(Error error, int step) const
 {
   QList<TextLine> result;
-  switch (error)
-  {
-  case Error_Syntax: result << TextLine("  Syn ERROR"); break;
-  case Error_Stack: result << TextLine("  Stk ERROR"); break;
-  case Error_Memory: result << TextLine("  Mem ERROR"); break;
-  case Error_Argument: result << TextLine("  Arg ERROR"); break;
-  case Error_Goto: result << TextLine("  Go  ERROR"); break;
-  case Error_Math: result << TextLine("  Ma  Error"); break;
-  case Error_Ne: result << TextLine("  Ne  Error"); break;
-  default:;
-  }
+  if (error != Error_No)
+    result << TextLine("  " + errorName(error));
   result << TextLine(QString("   Step    %1").arg(step));
   return result;
 }
@@ -373,101 +729,109 @@ void Interpreter::display(const QList<TextLine> &lines)
   foreach (const TextLine &textLine, lines)
   {
     storeDisplayLine(textLine);
-    emit displayLine();
   }
 }
 
-void Interpreter::parseVariableAndStore(double d)
+void Interpreter::displayLastResult()
 {
-  // Parse a variable or a array var
-  int varPrefix = readAlpha();
-
-  int index = 0;
-  if (eatEntity(LCDChar_OpenBracket)) // Array var
+  if (_quiet) // Formatted later, if ever
   {
-    index = (int) _expressionSolver.solve(program(), _currentOffset);
-    if (!eatEntity(LCDChar_CloseBracket))
-      throw InterpreterException(Error_Syntax, _currentOffset);
+    ScreenLine &screenLine = nextScreenLine();
+    screenLine.isNumber = true;
+    screenLine.number = _lastResult;
+    return;
   }
-  // Next entity is separator or end
-  if (!isSeparator(currentEntity()) && currentEntity() != -1)
-    throw InterpreterException(Error_Syntax, _currentOffset);
+
+  TextLine textLine = formatDouble(_lastResult);
+  textLine.setRightJustified(true);
+  storeDisplayLine(textLine);
+}
+
+bool Interpreter::store(const CompiledProgram::Instruction &instruction, double d)
+{
+  double index = 0.0;
+  if (instruction.indexExpression >= 0 && // Array var
+      !_expressionSolver.evaluate(compiledProgram().expression(instruction.indexExpression), index, _runError))
+    return false;
 
   // Stock it
-  if (!Memory::instance().setVariable((LCDChar) varPrefix, index, d))
-    throw InterpreterException(Error_Memory, _currentOffset);
+  if (!_context->memory().setVariable((LCDChar) instruction.variable, (int) index, d))
+    return fail(Error_Memory, instruction.errorOffset);
+  if (_trace)
+    _trace->store(instruction.variable - LCDChar_A + (int) index, d);
+  if (_history)
+    _history->write(instruction.variable - LCDChar_A + (int) index);
+  return true;
 }
 
 void Interpreter::changeAngleMode(int entity)
 {
   switch (entity)
   {
-  case LCDOp_Deg: CalculatorState::instance().setAngleMode(Deg); break;
-  case LCDOp_Rad: CalculatorState::instance().setAngleMode(Rad); break;
-  case LCDOp_Gra: CalculatorState::instance().setAngleMode(Grad); break;
+  case LCDOp_Deg: _context->setAngleMode(Deg); break;
+  case LCDOp_Rad: _context->setAngleMode(Rad); break;
+  case LCDOp_Gra: _context->setAngleMode(Grad); break;
   default:;
   }
-  readEntity();
 }
 
-void Interpreter::parseInput(const TextLine &prefix)
+bool Interpreter::storeInput(const CompiledProgram::Instruction &instruction)
 {
-  if (!eatEntity(LCDChar_Question))
-    throw InterpreterException(Error_Syntax, _currentOffset);
-
-  TextLine toDisplay = prefix;
-  toDisplay << LCDChar_Question;
-
-  storeDisplayLine(toDisplay);
-  emit displayLine();
-  if (!eatEntity(LCDChar_Arrow)) // Pass the "->"
-    throw InterpreterException(Error_Syntax, _currentOffset);
-  // Wait for user data
-  _waitForInput = true;
-  _inputMutex.lock();
-  _inputWaitCondition.wait(&_inputMutex);
-  _inputMutex.unlock();
-
-  int offset = 0;
-  double d = _expressionSolver.solve(_input, offset);
+  // Compiling the input still throws, off the hot path
+  double d;
+  try
+  {
+    int offset = 0;
+    d = _expressionSolver.solve(_input, offset);
+  } catch (InterpreterException exception)
+  {
+    return fail(exception.error(), exception.offset());
+  }
   _lastResult = d;
 
   // Compute the destination
-  parseVariableAndStore(d);
+  return store(instruction, d);
 }
 
-bool Interpreter::parseProg()
+bool Interpreter::callProg(int programIndex)
 {
-  readEntity(); // Pass the "prog "
-  if (!isCipher(currentEntity()))
-    throw InterpreterException(Error_Argument, _currentOffset);
-  int cipher = readEntity(); // Pass the cipher
-  if (!isSeparator(currentEntity()) && currentEntity() != -1)
-    throw InterpreterException(Error_Argument, _currentOffset);
-
   // Change the program
-  Program *program = Memory::instance().programAt(cipher);
+  Program *program = _context->memory().programAt(programIndex);
   if (program->count())
   {
-    _callStack.push(ProgramIndex(_currentProgramIndex, _currentOffset));
-    _currentProgramIndex = cipher;
-    _currentOffset = 0;
+    _callStack.push(ProgramIndex(_currentProgramIndex, _currentInstruction));
+    setCurrentProgram(programIndex);
+    _currentInstruction = 0;
     return true;
   }
   return false;
 }
 
-void Interpreter::parseDefm()
+bool Interpreter::stepCounter(const CompiledProgram::Instruction &instruction, bool &zero)
 {
-  readEntity(); // Pass the "defm"
+  double index = 0.0;
+  if (instruction.indexExpression >= 0 && // Array var
+      !_expressionSolver.evaluate(compiledProgram().expression(instruction.indexExpression), index, _runError))
+    return false;
 
-  if (isCipher(currentEntity()) || currentEntity() == LCDChar_Dot)
-  {
-    int mem = (int) roundf(ExpressionSolver::parseNumber(program(), _currentOffset));
+  double *slot = _context->memory().variableSlot(instruction.operand + (int) index);
+  if (!slot)
+    return fail(Error_Memory, instruction.errorOffset);
+  *slot += instruction.op == CompiledProgram::Op_Isz ? 1.0 : -1.0;
+  zero = *slot == 0.0;
+  if (_trace)
+    _trace->store(instruction.operand + (int) index, *slot);
+  if (_history)
+    _history->write(instruction.operand + (int) index);
+  return true;
+}
 
-    // Try to set the memory
-    if (!Memory::instance().setExtraVarCount(mem))
-      throw InterpreterException(Error_Argument, _currentOffset);
-  } else if (!isSeparator(currentEntity()) && currentEntity() != -1)
-    throw InterpreterException(Error_Argument, _currentOffset);
+bool Interpreter::defm(const CompiledProgram::Instruction &instruction)
+{
+  // Try to set the memory
+  if (instruction.operand >= 0 && !_context->memory().setExtraVarCount(instruction.operand))
+    return fail(Error_Argument, instruction.errorOffset);
+  if (_history)
+    _history->defm();
+  return true;
 }
@@ -1,44 +1,174 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QStack>
 #include <QThread>
-#include <QQueue>
-#include <QMutex>
-#include <QWaitCondition>
 
 #include "misc.h"
+#include "compiled_program.h"
+#include "execution_history.h"
+#include "execution_profiler.h"
+#include "execution_trace.h"
 #include "expression_solver.h"
+#include "input_provider.h"
+#include "memory.h"
+#include "speed_governor.h"
+#include "spsc_channel.h"
 
 class Interpreter : public QThread
 {
   Q_OBJECT
 
 public:
-  Interpreter(const QList<TextLine> &program = QList<TextLine>());
+  enum Status {
+    Status_Finished,
+    Status_NeedsInput,      // Suspended on "?"
+    Status_NeedsValidation, // Suspended on a pause
+    Status_Stopped          // Stopped before a statement by seek() or the debugging
+  };
+
+  enum StopReason {
+    Stop_Seek,
+    Stop_Breakpoint,
+    Stop_Watchpoint,
+    Stop_Step
+  };
+
+  Interpreter(const QList<TextLine> &program = QList<TextLine>(),
+              EmulatorContext &context = EmulatorContext::defaultContext());
+  ~Interpreter();
+
+  EmulatorContext &context() const { return *_context; }
 
   void setProgram(const QList<TextLine> &program);
 
-  void run();
+  // Interprets the program in the calling thread, waiting for sendInput() and sendValidation().
+  // A stop of the debugging is validated like a pause, after stopped()
+  void interpret();
+
+  // Interprets the program in the calling thread until it ends or waits for the user, then returns at once.
+  // All the run state stays in the interpreter, so a suspended run holds no thread and can be resumed by any.
+  Status execute();
+  // Continues a suspended run, <value> being the "?" input. After cancel(), ends the run with Error_Break
+  Status resume(const TextLine &value = TextLine());
+  Status status() const { return _status; }
+
+  // Next statement of a suspended or stopped run
+  int currentProgram() const { return _currentProgramIndex; } // -1 for the main program
+  int currentOffset() const; // In the raw steps, -1 if the run is finished
+
+  // Debugging, taken into account when a run starts or resumes. The run is Status_Stopped before a statement
+  // with a breakpoint, after a statement changing a watched variable, or before each statement in single-step.
+  // Nothing is checked while no debugging is set, so the interpretation is as fast as without.
+  // Not thread safe: only change them while no run is going on, stopped and suspended ones included
+  StopReason stopReason() const { return _stopReason; }
+  int stopVariable() const { return _stopVariable; } // The changed variable of Stop_Watchpoint
+  // Breakpoint on the statement holding the raw steps <offset> of <program> (-1 for the main program), as it is
+  // compiled now
+  void setBreakpoint(int program, int offset, bool enabled = true);
+  bool hasBreakpoint(int program, int offset) const;
+  void clearBreakpoints();
+  // <variable> is the slot of a variable: A is 0, Z is 25, A[n] is n
+  void setWatchpoint(int variable, bool enabled = true);
+  void clearWatchpoints();
+  bool isSingleStep() const { return _singleStep; }
+  void setSingleStep(bool value) { _singleStep = value; }
+  bool isDebugging() const { return _singleStep || _breakpointCount || _watchpoints.count(); }
+
+  // Queues <program> for the worker thread, started by the first call and kept for the next ones.
+  // A short program which can't wait for the user nor loop is interpreted at once in the calling thread instead,
+  // never sleeping for the real hardware speed.
+  // jobFinished() is emitted after each program. Returns false if too many programs are waiting
+  bool submit(const QList<TextLine> &program);
+  bool isBusy() const { return _pendingJobs; } // A submitted program isn't finished yet
+  void stopWorker(); // Breaks the current program, forgets the waiting ones and ends the worker thread
 
-  TextLine getNextDisplayLine();
+  // No "?", pause, Goto nor Prog, and a few statements at most
+  static bool canRunInline(const QList<TextLine> &program);
 
-  bool waitForInput() const { return _waitForInput; }
-  bool waitForValidation() const { return _waitForValidation; }
+  // All the lines displayed since the last call. displayLine() is emitted once the lines
+  // start waiting again, so a single call per signal is enough
+  QList<TextLine> takeDisplayLines();
+
+  // Quiet mode, for batch runs: nothing is queued nor signalled, only the last <screenLineCount> lines
+  // of the run are kept like the LCD, and the numbers among them are formatted by screenLines() only
+  bool isQuiet() const { return _quiet; }
+  void setQuiet(bool value) { _quiet = value; }
+  QList<TextLine> screenLines() const;
+  static const int screenLineCount = 8;
+
+  // "?" and pauses are answered by <provider> instead of sendInput() and sendValidation(), 0 to wait for them again.
+  // The provider is not owned.
+  InputProvider *inputProvider() const { return _inputProvider; }
+  void setInputProvider(InputProvider *provider) { _inputProvider = provider; }
+
+  bool waitForInput() const { return _waitState == Wait_Input; }
+  bool waitForValidation() const { return _waitState == Wait_Validation; }
   void sendInput(const TextLine &value);
   void sendValidation();
 
   bool error() const { return _error; }
+  Error lastError() const { return _lastError; } // Error_No if the last execution succeeded
   int errorStep() const { return _errorStep; }
 
   double lastResult() const { return _lastResult; }
 
   bool displayDefm() const { return _displayDefm; }
 
+  // The run ends with Error_Break after <value> statements, 0 for no limit
+  qint64 stepBudget() const { return _stepBudget; }
+  void setStepBudget(qint64 value) { _stepBudget = value; }
+  // The run ends with Error_Break after <msecs> milliseconds, 0 for no limit. Checked between statements only
+  qint64 deadline() const { return _deadline; }
+  void setDeadline(qint64 msecs) { _deadline = msecs; }
+  // Thread safe: breaks the run like AC, even while waiting for an input or a validation.
+  // A suspended run is only broken by its next resume(), a queued one at its first statement.
+  // The programs submitted after it aren't broken
+  void cancel();
+
+  qint64 executedSteps() const { return _executedSteps; } // Statements executed by the last run
+
+  // Statements are profiled while a profiler is set (not owned), 0 to stop
+  ExecutionProfiler *profiler() const { return _profiler; }
+  void setProfiler(ExecutionProfiler *profiler) { _profiler = profiler; }
+
+  // Each run is recorded into <trace> (not owned) while it is set, 0 to stop
+  ExecutionTrace *trace() const { return _trace; }
+  void setTrace(ExecutionTrace *trace) { _trace = trace; }
+
+  // Each run takes periodic checkpoints into <history> (not owned) while it is set, 0 to stop
+  ExecutionHistory *history() const { return _history; }
+  void setHistory(ExecutionHistory *history) { _history = history; }
+  // Goes back (or forward) to the state of the recorded run after <step> statements: the last checkpoint before
+  // is restored and the next statements are interpreted again, quietly and with the recorded inputs.
+  // The programs must not have changed, and the display is not restored. The run is then Status_Stopped
+  // (or Status_Finished at its end) and resume() goes on from there, replacing the recorded end of the run.
+  // Returns false if the history doesn't hold <step>
+  bool seek(qint64 step);
+
+  const SpeedGovernor &speedGovernor() const { return _speedGovernor; }
+  void setSpeedMode(SpeedGovernor::Mode mode) { _speedGovernor.setMode(mode); }
+
 signals:
   void displayLine();
+  void askForInput();
   void askForValidation();
+  void jobFinished();
+  void stopped(); // interpret() waits for sendValidation() after a stop of the debugging
+
+protected:
+  void run(); // Worker thread loop
 
 private:
+  enum WaitState {
+    Wait_None,
+    Wait_Input,
+    Wait_Validation
+  };
+
   class ProgramIndex // Search for a better name
   {
   public:
@@ -46,53 +176,120 @@ private:
     ProgramIndex(int p, int s) : program(p), step(s) {}
 
     int program; // 0 -> 9
-    int step;
+    int step; // Instruction index
+  };
+
+  static const int _inlineStatementLimit = 4;
+
+  class ScreenLine
+  {
+  public:
+    ScreenLine() : isNumber(false), number(0.0) {}
+
+    bool isNumber; // <number> is still to be formatted, else <textLine> is used
+    double number;
+    TextLine textLine;
+  };
+
+  class Job
+  {
+  public:
+    Job(const QList<TextLine> &program = QList<TextLine>(), int id = 0) : program(program), id(id) {}
+
+    QList<TextLine> program;
+    int id; // From 1, in the order of submit()
   };
 
-  QQueue<TextLine> _displayLines;
+  SpscChannel<Job, 8> _jobs; // Submitted to the worker thread
+  QAtomicInt _pendingJobs; // Submitted and not finished yet
+  QAtomicInt _lastJobId; // Of the last submit()
+  QAtomicInt _cancelledJobId; // cancel() breaks the jobs up to this id, even the ones not started yet
+  SpscQueue<TextLine> _displayLines;
+  QAtomicInt _displayPending; // displayLine() emitted and takeDisplayLines() not called yet
+  bool _quiet;
+  ScreenLine _screenLines[screenLineCount]; // Ring of the quiet mode lines
+  int _screenLineEnd;
+  int _screenLineTotal; // Lines displayed by the quiet run
   TextLine _program;
-  int _currentProgramIndex; // -1 => use _program, else use Memory::instance()
-  int _currentOffset;
-  QMutex _displayLineMutex;
+  CompiledProgram _compiledProgram; // Compiled form of <_program>
+  int _currentProgramIndex; // -1 => use _program, else use the context memory
+  const CompiledProgram *_code; // Of <_currentProgramIndex>, only changed by setCurrentProgram()
+  int _currentInstruction;
+  Status _status;
+  int _suspendedInstruction; // Op_Input or Op_Pause the run is suspended on
+  EmulatorContext *_context;
   ExpressionSolver _expressionSolver;
   bool _error; // If true then the last execution failed
+  Error _lastError;
   int _errorStep; // The last error step
   double _lastResult;
   TextLine _input;
-  bool _waitForInput;
-  bool _waitForValidation;
+  QAtomicInt _waitState; // WaitState, only an answer to the current wait is accepted
+  SpscChannel<TextLine, 4> _answers; // From sendInput() and sendValidation() to the interpreter thread
+  InputProvider *_inputProvider;
   bool _displayDefm;
-  QMutex _inputMutex;
-  QWaitCondition _inputWaitCondition;
+  bool _displayLastNumber;
   QStack<ProgramIndex> _callStack;
+  SpeedGovernor _speedGovernor;
+  ExecutionProfiler *_profiler;
+  ExecutionTrace *_trace;
+  ExecutionHistory *_history;
+  qint64 _stepBudget;
+  qint64 _deadline;
+  qint64 _stopStep; // Statements to execute before stopping, -1 for no stop
+  int _seekInputCount; // Recorded inputs consumed up to the seeked step, -1 if the run wasn't seeked
+  StopReason _stopReason;
+  int _stopVariable;
+  QSet<int> _breakpoints[Memory::programsCount + 1]; // Statement offsets, the main program ones first
+  int _breakpointCount;
+  QVector<int> _watchpoints;
+  QVector<double> _watchValues; // Since the last check
+  bool _singleStep;
+  bool _debugSkip; // The statement a run is resumed on doesn't stop it again
+  qint64 _nextCheck; // checkStatement() is called once <_executedSteps> goes beyond
+  qint64 _executedSteps;
+  QElapsedTimer _runTimer;
+  QAtomicInt _cancelRequested;
+  ErrorStatus _runError; // Error ending the current run
+
+  void runJob(const Job &job, bool inlined); // <inlined> in the submit() thread
+  void finishJob();
+  Status continueExecution(); // Runs until the end or the next suspension, errors included
+  // Status_Finished with <_runError> set on error. The <debug> instantiation is only used while debugging
+  template <bool debug> Status executeInstructions();
+  void finishExecution(); // Ends the run, with an error if <_runError> is set
 
-  void execute() throw (InterpreterException);
+  // Errors are returned as false with <_runError> set, exceptions are too slow for the dispatch loop
+  bool fail(Error error, int offset); // Sets <_runError> and returns false
+  // Called before a statement when a limit may be reached. Returns false with <_runError> set to break the run,
+  // and without to stop it before the statement
+  bool checkStatement(int offset);
+  void takeCheckpoint(); // Before the current statement
+  bool checkDebug(int offset); // Returns false to stop before the statement at <offset>
+  int statementOffset(int program, int offset) const; // Start of the statement holding <offset>
 
-  int currentEntity() const;
-  int readEntity(); // Returns -1 if it the end of file
-  bool eatEntity(int entity); // Returns true if entity is eaten
-  int readAlpha() throw (InterpreterException); // Returns an alpha
-  int indexOfEntity(int entity, int from) const;
-  int entityAt(int index) const;
-  const TextLine &program() const;
+  // Looks the program up once, on Prog calls and returns, instead of on each access
+  void setCurrentProgram(int index);
+  const CompiledProgram &compiledProgram() const { return *_code; }
 
   // Returns true if (d1 comp d2) is true
   bool computeBoolean(int comp, double d1, double d2);
-  void moveOffsetToNextInstruction();
 
   void storeDisplayLine(const TextLine &textLine);
+  ScreenLine &nextScreenLine(); // Recycles the oldest quiet mode line
 
   QList<TextLine> errorLines(Error error, int step) const;
 
-  TextLine parseString();
-  void parseLabel();
-  void parseGoto();
-  bool parseProg();
-  void parseVariableAndStore(double d);
-  void parseInput(const TextLine &prefix = TextLine());
-  void parseDefm();
+  bool callProg(int programIndex); // Returns false if the program is empty
+  bool store(const CompiledProgram::Instruction &instruction, double d);
+  bool storeInput(const CompiledProgram::Instruction &instruction);
+  bool defm(const CompiledProgram::Instruction &instruction);
+  bool stepCounter(const CompiledProgram::Instruction &instruction, bool &zero); // Dsz/Isz, <zero> if 0 is reached
+  bool pause(); // Returns true to suspend the run until the user validation
+  void waitForAnswer(Status status, TextLine &answer); // Returns at once if cancelled
 
   void display(const QList<TextLine> &lines);
+  void displayLastResult();
 
   void changeAngleMode(int entity);
 };
@@ -9,11 +9,14 @@ void Program::setSteps(const QList<TextLine> &value)
 {
   _steps = value;
   _rawSteps.affect(value);
+  _compiledProgram.compile(_rawSteps);
 }
 
 void Program::clear()
 {
   _steps.clear();
+  _rawSteps.clear();
+  _compiledProgram.clear();
 }
 
 int Program::entityAt(int step)
@@ -37,17 +40,22 @@ Memory *Memory::_instance = 0;
 Memory &Memory::instance()
 {
   if (!_instance)
-    _instance = new Memory;
+    _instance = new Memory(true);
 
   return *_instance;
 }
 
-Memory::Memory() :
+Memory::Memory(bool demoPrograms) :
   _extraVarCount(0),
   _freeSteps(_freeStepsMax)
 {
   clearVariables();
+  if (demoPrograms)
+    setDemoPrograms();
+}
 
+void Memory::setDemoPrograms()
+{
   QList<TextLine> steps;
   steps << TextLine("\"Z0=\"?{->}Y");
   steps << TextLine("\"Z1=\"?{->}Z");
@@ -171,7 +179,7 @@ int Memory::totalProgramsSize() const
 
 double Memory::variable(int index, bool *overflow)
 {
-  if (index < 26 + _extraVarCount)
+  if (index >= 0 && index < 26 + _extraVarCount)
   {
     if (overflow)
       *overflow = false;
@@ -193,7 +201,7 @@ double Memory::variable(LCDChar c, int index, bool *overflow)
 
 bool Memory::setVariable(int index, double value)
 {
-  if (index >= 26 + _extraVarCount)
+  if (index < 0 || index >= 26 + _extraVarCount)
     return false;
 
   _variables[index] = value;
@@ -207,6 +215,13 @@ bool Memory::setVariable(LCDChar c, int index, double value)
   return setVariable(c - LCDChar_A + index, value);
 }
 
+double *Memory::variableSlot(int index)
+{
+  if (index < 0 || index >= 26 + _extraVarCount)
+    return 0;
+  return &_variables[index];
+}
+
 void Memory::clearVariables()
 {
   for (int i = 0; i < (int) (sizeof(_variables) / sizeof(double)); ++i)
@@ -3,6 +3,7 @@
 
 #include <QMap>
 
+#include "compiled_program.h"
 #include "misc.h"
 
 class Program
@@ -18,6 +19,7 @@ public:
   int entityAt(int step);
   int indexOf(int entity, int from);
   const TextLine &rawSteps() const { return _rawSteps; }
+  const CompiledProgram &compiledProgram() const { return _compiledProgram; } // Compiled by setSteps()
 
   int size() const; // In steps
   int count() const { return size(); } // Like size
@@ -27,12 +29,17 @@ public:
 private:
   QList<TextLine> _steps;
   TextLine _rawSteps;
+  CompiledProgram _compiledProgram;
 };
 
 class Memory
 {
 public:
   static const int programsCount = 10;
+  static const int variablesCount = 26 + 500; // A-Z then the Defm ones
+
+  // Use instance() for the calculator window memory, the only one with the demo programs in Prog 0-2
+  Memory(bool demoPrograms = false);
 
   static Memory &instance();
 
@@ -46,9 +53,10 @@ public:
   int freeSteps() const;
 
   double variable(LCDChar c, int index = 0, bool *overflow = 0); // Return 0 is index > 26 + _extraVarCount
-  double variable(int index, bool *overflow = 0); // Return 0 is index > 26 + _extraVarCount
-  bool setVariable(int index, double value); // Return false if index > 26 + _extraVarCount
+  double variable(int index, bool *overflow = 0); // Return 0 is index < 0 or > 26 + _extraVarCount
+  bool setVariable(int index, double value); // Return false if index < 0 or > 26 + _extraVarCount
   bool setVariable(LCDChar c, int index, double value); // Return false if overflow
+  double *variableSlot(int index); // Returns 0 if index is out of A-Z and the extra variables
   int extraVarCount() const { return _extraVarCount; }
   bool setExtraVarCount(int value); // Returns false is value is invalid
 
@@ -58,12 +66,11 @@ private:
   static Memory *_instance;
   Program _programs[10];
   int _extraVarCount;
-  double _variables[526]; // Memory
+  double _variables[variablesCount]; // Memory
   int _freeSteps;
 
-  Memory();
-
   int totalProgramsSize() const;
+  void setDemoPrograms();
 };
 
 #endif
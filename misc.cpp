@@ -268,6 +268,44 @@ QList<LCDChar> stringToChars(const QString &str)
   return list;
 }
 
+QString charsToString(const QList<LCDChar> &chars)
+{
+  QString str;
+  foreach (LCDChar c, chars)
+  {
+    switch (c)
+    {
+    case LCDChar_MinusPrefix: str.append('-'); break;
+    case LCDChar_Exponent: str.append('E'); break;
+    case LCDChar_Multiply: str.append('*'); break;
+    case LCDChar_Arrow: str.append("->"); break;
+    case LCDChar_DoubleArrow: str.append("=>"); break;
+    case LCDChar_Different: str.append("/="); break;
+    case LCDChar_GreaterEqual: str.append(">="); break;
+    case LCDChar_LessEqual: str.append("<="); break;
+    case LCDChar_RBTriangle: str.append('>'); break;
+    case LCDChar_CR: str.append('\n'); break;
+    default:
+      {
+        // Reverse of charToLCDChar()
+        bool found = false;
+        for (char ch = ' '; ch <= '~' && !found; ++ch)
+        {
+          bool valid;
+          if (charToLCDChar(QChar(ch), &valid) == c && valid)
+          {
+            str.append(ch);
+            found = true;
+          }
+        }
+        if (!found)
+          str.append('#');
+      }
+    }
+  }
+  return str;
+}
+
 bool isLCDChar(int entity)
 {
   return entity >= 0 && entity < 256;
@@ -1292,6 +1330,44 @@ TextLine formatDouble(double d)
   return result;
 }
 
+QString errorName(Error error)
+{
+  switch (error)
+  {
+  case Error_Syntax: return "Syn ERROR";
+  case Error_Stack: return "Stk ERROR";
+  case Error_Memory: return "Mem ERROR";
+  case Error_Argument: return "Arg ERROR";
+  case Error_Goto: return "Go  ERROR";
+  case Error_Math: return "Ma  Error";
+  case Error_Ne: return "Ne  Error";
+  case Error_Break: return "Break";
+  default: return QString();
+  }
+}
+
+void getLineAndStep(const QList<TextLine> &program, int offset, int &line, int &step)
+{
+  // Lines are joined as by TextLine::affect(): a CR after each one, except after a ◢ ending it.
+  // The CR or the ◢ belongs to its line, an offset past the end to the last one
+  line = 0;
+  step = 0;
+  if (program.isEmpty())
+    return;
+  int index = 0; // Of the first entity of <line>
+  while (line < program.count() - 1)
+  {
+    const TextLine &textLine = program[line];
+    int next = index + textLine.count() + (textLine.isBreakerEndedLine() ? 0 : 1);
+    if (offset < next)
+      break;
+    index = next;
+    ++line;
+  }
+
+  step = program[line].offsetAt(offset - index);
+}
+
 void TextLine::affect(QList<TextLine> lines)
 {
   clear();
@@ -138,6 +138,7 @@ enum LCDChar {
 
 LCDChar charToLCDChar(const QChar &c, bool *found = 0);
 QList<LCDChar> stringToChars(const QString &str);
+QString charsToString(const QList<LCDChar> &chars); // ASCII approximation, for the command line tools
 int idToEntity(const QString &id);
 
 // 'Log', 'Ln', all atomic entities
@@ -415,6 +416,9 @@ private:
 
 TextLine formatDouble(double d);
 
+// Converts a raw steps <offset> of <program> into a line index and a char offset in that line
+void getLineAndStep(const QList<TextLine> &program, int offset, int &line, int &step);
+
 enum Error {
   Error_No,
   Error_Syntax,
@@ -423,13 +427,33 @@ enum Error {
   Error_Argument,
   Error_Goto,
   Error_Math,
-  Error_Ne
+  Error_Ne,
+  Error_Break // AC, step budget or deadline
+};
+
+// As displayed by the calculator, e.g. "Syn ERROR". Empty for Error_No
+QString errorName(Error error);
+
+// Error and offset returned by value where throwing is too slow (interpreter and solver hot paths)
+class ErrorStatus
+{
+public:
+  ErrorStatus(Error error = Error_No, int offset = 0) : _error(error), _offset(offset) {}
+
+  bool isError() const { return _error != Error_No; }
+  Error error() const { return _error; }
+  int offset() const { return _offset; }
+
+private:
+  Error _error;
+  int _offset;
 };
 
 class InterpreterException
 {
 public:
   InterpreterException(Error error, int offset = 0) : _error(error), _offset(offset) {}
+  InterpreterException(const ErrorStatus &status) : _error(status.error()), _offset(status.offset()) {}
 
   Error error() const { return _error; }
   int offset() const { return _offset; }
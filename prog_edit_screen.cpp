@@ -10,3 +10,27 @@ void ProgEditScreen::buttonClicked(int button)
   default:;
   }
 }
+
+int ProgEditScreen::cursorStep() const
+{
+  if (cursorLineIndex() >= _lines.count())
+    return 0;
+
+  TextLine rawTextLine;
+  rawTextLine.affect(_lines.mid(0, cursorLineIndex() + 1));
+  const TextLine &line = _lines[cursorLineIndex()];
+  return rawTextLine.count() - line.count() + line.entityAt(cursorOffset());
+}
+
+void ProgEditScreen::showStep(int offset)
+{
+  if (!_lines.count())
+    return;
+
+  int line, step;
+  getLineAndStep(_lines, offset, line, step);
+  moveCursor(line, step);
+  feedScreen();
+  emit screenChanged();
+  restartBlink();
+}
@@ -10,6 +10,10 @@ public:
   ProgEditScreen() : EditorScreen() {}
 
   void buttonClicked(int button);
+
+  // In the raw steps of the program, see getLineAndStep()
+  int cursorStep() const;
+  void showStep(int offset); // Moves the cursor to <offset>, e.g. where a run is stopped
 };
 
 #endif
@@ -1,96 +1,23 @@
-#include "program_parser.h"
+#include "compiled_program.h"
 
-ProgramParser::ProgramParser(const QList<TextLine> &program) :
-  _lines(program),
-  _currentLine(0), _currentOffset(0)
-{
-}
+#include "program_parser.h"
 
-Token ProgramParser::readToken()
+ProgramParser::ProgramParser(const QList<TextLine> &program)
 {
-  if (_currentLine > _lines.count() - 1)
-    return Token(Token::Type_EOF);
+  TextLine rawSteps;
+  rawSteps.affect(program);
+  CompiledProgram code;
+  code.compile(rawSteps);
 
-  const TextLine &textLine = _lines[_currentLine];
-
-  Token token(_currentLine, _currentOffset);
-  int entity = textLine[_currentOffset];
-
-  if (isAlpha(entity))
+  // Each faulty statement is compiled into an error instruction
+  for (int i = 0; i < code.count(); ++i)
   {
-    bool linePassed;
-    int nEntity = nextEntity(&linePassed);
+    const CompiledProgram::Instruction &instruction = code.at(i);
+    if (instruction.op != CompiledProgram::Op_Error)
+      continue;
 
-    if (!linePassed && nEntity == LCDChar_OpenBracket)
-    {
-      token.setToken(Token::Type_OpenArrayVar, TextLine() << entity << nEntity);
-      nextEntity(); // Pass the [
-    } else // A regular entity
-      token.setToken(Token::Type_Entity, TextLine() << entity);
-  } else if (isCipher(entity) || entity == LCDChar_Dot)
-  {
-    TextLine numberLine;
-    numberLine << entity;
-    bool linePassed;
-    while ((entity = nextEntity(&linePassed)) != -1)
-    {
-      if (!linePassed && (isCipher(entity) || entity == LCDChar_Dot))
-      {
-        // Continue the number
-        if (isCipher(entity) || numberLine.indexOf(LCDChar_Dot) < 0)
-          numberLine << entity;
-        else
-          throw Exception(Error_Syntax);
-      } else
-        break;
-    }
-    token.setToken(Token::Type_Number, numberLine);
-  } else if (entity == LCDChar_DoubleQuote) // A string
-  {
-    TextLine rawLine;
-    rawLine << LCDChar_DoubleQuote;
-    bool linePassed;
-    while ((entity = nextEntity(&linePassed)) != -1)
-    {
-      if (entity == LCDChar_DoubleQuote)
-      {
-        token.setToken(Token::Type_String, rawLine << LCDChar_DoubleQuote);
-        break;
-      }
-      else if (linePassed)
-        rawLine << LCDChar_CR;
-      else
-        rawLine << entity;
-    }
-    if (entity == -1) // Failed to close the string
-      throw Exception(Error_Syntax);
-  } else
-  { // A regular entity
-    token.setToken(Token::Type_Entity, TextLine() << entity);
-    nextEntity();
+    Diagnostic diagnostic((Error) instruction.operand, instruction.errorOffset);
+    getLineAndStep(program, diagnostic.step, diagnostic.line, diagnostic.offset);
+    _diagnostics << diagnostic;
   }
-
-  return token;
-}
-
-int ProgramParser::nextEntity(bool *linePassed)
-{
-  if (linePassed)
-    *linePassed = false;
-  if (_currentLine >= _lines.count())
-    return -1;
-
-  const TextLine &textLine = _lines[_currentLine];
-  if (_currentOffset >= textLine.count() - 1)
-  {
-    if (linePassed)
-      *linePassed = true;
-    _currentLine++;
-  } else
-    _currentOffset++;
-
-  if (_currentLine >= _lines.count())
-    return -1;
-
-  return _lines[_currentLine][_currentOffset];
 }
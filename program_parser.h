@@ -3,33 +3,29 @@
 
 #include "misc.h"
 
+// Checks a whole program once, before running it: all the errors found by the compilation (Syn, Arg, Go,
+// Stk for too deep expressions) are reported with their place, while a run only raises the first one it reaches.
+// The checks are the ones of the compilation (see CompiledProgram), so both always agree
 class ProgramParser
 {
 public:
-  enum Error {
-    Error_No,
-    Error_Syntax,
-    Error_Stack,
-    Error_Memory
-  };
-
-  class Exception {
+  class Diagnostic
+  {
   public:
-    Exception(Error err, int l = 0, int o = 0) : error(err), line(l), offset(o) {}
+    Diagnostic(Error e = Error_No, int s = 0) : error(e), step(s), line(0), offset(0) {}
     Error error;
-    int line;
-    int offset;
+    int step;   // In the raw steps, like Interpreter::errorStep()
+    int line;   // Index of the program line
+    int offset; // In the line, like the editor cursor
   };
 
   ProgramParser(const QList<TextLine> &program);
 
-private:
-  QList<TextLine> _lines;
-  int _currentLine;
-  int _currentOffset;
+  bool isValid() const { return _diagnostics.isEmpty(); }
+  const QList<Diagnostic> &diagnostics() const { return _diagnostics; } // Ordered by step
 
-  Token readToken();
-  int nextEntity(bool *linePassed = 0); // Returns -1 if we were at the end of all
+private:
+  QList<Diagnostic> _diagnostics;
 };
 
 #endif
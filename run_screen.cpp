@@ -7,8 +7,10 @@ RunScreen::RunScreen() :
   _lastResult(0.0)
 {
   connect(&_interpreter, SIGNAL(displayLine()), this, SLOT(interpreterDisplayLine()), Qt::QueuedConnection);
-  connect(&_interpreter, SIGNAL(finished()), this, SLOT(interpreterFinished()));
+  // Short programs run inline: jobFinished() is then emitted before the queued displayLine()
+  connect(&_interpreter, SIGNAL(jobFinished()), this, SLOT(interpreterFinished()));
   connect(&_interpreter, SIGNAL(askForValidation()), this, SLOT(interpreterAskForValidation()));
+  connect(&_interpreter, SIGNAL(stopped()), this, SLOT(interpreterStopped()));
 
   _timerDisplay.setInterval(10);
   connect(&_timerDisplay, SIGNAL(timeout()), this, SLOT(timerDisplayTimeout()));
@@ -18,7 +20,16 @@ void RunScreen::buttonClicked(int button)
 {
   int entity = CalculatorState::instance().printableEntityByButton(button);
 
-  if (_interpreter.isRunning() && !_interpreter.waitForInput() && !_interpreter.waitForValidation())
+  // AC breaks the running program
+  if (button == Button_Ac && _interpreter.isBusy())
+  {
+    if (_interpreter.waitForValidation())
+      _lines.removeLast(); // Remove "- Disp -" or "- Stop -"
+    _interpreter.cancel();
+    return;
+  }
+
+  if (_interpreter.isBusy() && !_interpreter.waitForInput() && !_interpreter.waitForValidation())
     return;
 
   if (_interpreter.waitForValidation())
@@ -94,7 +105,7 @@ void RunScreen::validate()
     _interpreter.sendInput(_lines[_lines.count() - 1]);
   else if (_interpreter.waitForValidation())
   {
-    // Remove "- Disp -"
+    // Remove "- Disp -" or "- Stop -"
     _lines.removeLast();
     feedScreen();
     emit screenChanged();
@@ -120,10 +131,7 @@ void RunScreen::validate()
 
     // Compute the program
     if (_lastProgram.count())
-    {
-      _interpreter.setProgram(_lastProgram);
-      _interpreter.start();
-    }
+      _interpreter.submit(_lastProgram);
   }
 }
 
@@ -157,9 +165,12 @@ void RunScreen::setWaitingMode(bool value)
 
 void RunScreen::interpreterDisplayLine()
 {
-  TextLine textLine = _interpreter.getNextDisplayLine();
+  // All the waiting lines, with a single refresh
+  QList<TextLine> lines = _interpreter.takeDisplayLines();
+  if (!lines.count())
+    return;
 
-  _lines << textLine;
+  _lines << lines;
 
   moveCursor(_lines.count() - 1, 0);
 
@@ -171,29 +182,13 @@ void RunScreen::interpreterDisplayLine()
   emit screenChanged();
 }
 
-void RunScreen::getLineAndStep(const QList<TextLine> &program, int offset, int &line, int &step) const
-{
-  TextLine rawTextLine;
-  rawTextLine.affect(program);
-  line = 0;
-  step = 0;
-  int index = 0;
-  for (int i = 0; i <= offset && i < rawTextLine.count(); ++i)
-    if (rawTextLine[i] == LCDChar_CR || rawTextLine[i] == LCDChar_RBTriangle)
-    {
-      line++;
-      index = i + 1;
-    }
-
-  step = program[line].offsetAt(offset - index);
-}
-
 void RunScreen::timerDisplayTimeout()
 {
 }
 
 void RunScreen::interpreterFinished()
 {
+  interpreterDisplayLine(); // Lines not signalled yet
   if (_interpreter.error())
   {
     _errorMode = true;
@@ -230,3 +225,15 @@ void RunScreen::interpreterAskForValidation()
   emit screenChanged();
   moveCursor(_lines.count() - 1, 0); // To scroll
 }
+
+void RunScreen::interpreterStopped()
+{
+  // Validated like a pause
+  TextLine textLine("- Stop -");
+  textLine.setRightJustified(true);
+  _lines << textLine;
+  feedScreen();
+  emit screenChanged();
+  moveCursor(_lines.count() - 1, 0); // To scroll
+  emit stopped(_interpreter.currentProgram(), _interpreter.currentOffset());
+}
@@ -12,8 +12,11 @@ public:
 
   void buttonClicked(int button);
 
+  Interpreter &interpreter() { return _interpreter; }
+
 signals:
   void displayDefm();
+  void stopped(int program, int offset); // <program> is -1 for the main program
 
 private:
   QList<TextLine> _lastProgram;
@@ -29,8 +32,6 @@ private:
   void displayLastProgram(bool cursorOnTop = false); // Empty <_lines> and paste <_lastProgram> inside
   void setWaitingMode(bool value);
 
-  void getLineAndStep(const QList<TextLine> &program, int offset, int &line, int &step) const;
-
   void resetScreen();
 
 private slots:
@@ -38,6 +39,7 @@ private slots:
   void timerDisplayTimeout();
   void interpreterFinished();
   void interpreterAskForValidation();
+  void interpreterStopped();
 };
 
 #endif
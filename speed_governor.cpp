@@ -0,0 +1,77 @@
+#include <QThread>
+
+#include "misc.h"
+
+#include "speed_governor.h"
+
+// QThread sleep functions are protected
+class Sleeper : public QThread
+{
+public:
+  static void usleep(unsigned long usecs) { QThread::usleep(usecs); }
+};
+
+SpeedGovernor::SpeedGovernor(Mode mode) :
+  _mode(mode),
+  _clock(0)
+{
+  reset();
+}
+
+void SpeedGovernor::setMode(Mode value)
+{
+  _mode = value;
+  reset();
+}
+
+void SpeedGovernor::reset()
+{
+  _clock = 0;
+  _timer.start();
+}
+
+void SpeedGovernor::statement(int entity)
+{
+  switch (_mode)
+  {
+  case Mode_Unthrottled: return;
+  case Mode_VirtualClock: _clock += statementCost(entity); return;
+  default:;
+  }
+
+  // Real hardware: never bank the time spent outside the interpreter (input waits, ...)
+  qint64 now = _timer.nsecsElapsed() / 1000;
+  if (_clock < now)
+    _clock = now;
+  _clock += statementCost(entity);
+
+  if (_clock - now >= _minimumSleep)
+    Sleeper::usleep(_clock - now);
+}
+
+qint64 SpeedGovernor::elapsed() const
+{
+  switch (_mode)
+  {
+  case Mode_VirtualClock: return _clock;
+  default: return _timer.nsecsElapsed() / 1000;
+  }
+}
+
+int SpeedGovernor::statementCost(int entity)
+{
+  // Not measured on a device: the default is the flat 10 ms the emulator used to sleep before each statement,
+  // and the others are scaled from it by how much more or less work the statement does.
+  // Empty statements and anything not listed take the default
+  switch (entity)
+  {
+  case LCDChar_DoubleQuote: return 12000; // Strings are slow to print
+  case LCDChar_Question: return 15000;
+  case LCDOp_Goto: return 6000; // The device scans the program for the label
+  case LCDOp_Deg: case LCDOp_Rad: case LCDOp_Gra: return 2000;
+  case LCDOp_Prog: return 5000;
+  case LCDOp_Defm: return 4000;
+  case LCDOp_Dsz: case LCDOp_Isz: return 4000; // No expression to solve
+  default: return 10000; // Expressions, affectations and tests
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef SPEED_GOVERNOR_H
+#define SPEED_GOVERNOR_H
+
+#include <QElapsedTimer>
+
+// Decides how long each interpreted statement takes
+class SpeedGovernor
+{
+public:
+  enum Mode {
+    Mode_Unthrottled,  // No delay at all
+    Mode_RealHardware, // Sleeps to match the fx-7500G statement timings
+    Mode_VirtualClock  // Never sleeps, only <elapsed()> advances (for tests)
+  };
+
+  SpeedGovernor(Mode mode = Mode_RealHardware);
+
+  Mode mode() const { return _mode; }
+  void setMode(Mode value);
+
+  void reset(); // Called at the start of each run
+
+  // Called before each statement, <entity> is its first entity
+  void statement(int entity);
+
+  // Microseconds spent since the last reset (emulated time for the virtual clock)
+  qint64 elapsed() const;
+
+  // Estimated fx-7500G duration of a statement beginning with <entity>, in microseconds (see the .cpp)
+  static int statementCost(int entity);
+
+private:
+  static const int _minimumSleep = 1000; // Don't sleep for less than that (microseconds)
+
+  Mode _mode;
+  qint64 _clock; // Emulated time in microseconds
+  QElapsedTimer _timer;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef SPSC_CHANNEL_H
+#define SPSC_CHANNEL_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+// Lock-free ring buffer between one producer thread and one consumer thread.
+// The consumer spins a little before sleeping; the producer only locks to wake a sleeping consumer.
+// <Capacity> - 1 items can be waiting.
+template <typename T, int Capacity = 16>
+class SpscChannel
+{
+public:
+  SpscChannel() : _head(0), _tail(0), _parked(0), _interrupted(0) {}
+
+  // Forgets the items and the interruption, when neither side is using the channel
+  void reset();
+
+  // Producer side, returns false if the channel is full
+  bool tryPush(const T &value);
+
+  // Consumer side, returns false if the channel is empty
+  bool tryPop(T &value);
+  // Waits for an item, spinning <spinCount> times before sleeping (-1 for defaultSpinCount()). Returns false if interrupted
+  bool pop(T &value, int spinCount = -1);
+
+  // Any thread: pop() returns false until reset()
+  void interrupt();
+  bool isInterrupted() const { return _interrupted; }
+
+  // A few dozens of microseconds, none on a single core where the producer can't run meanwhile
+  static int defaultSpinCount();
+
+private:
+  static const int _cacheLineSize = 64;
+
+  T _items[Capacity];
+  // Each side spins on the index written by the other one: keep them on their own cache line
+  char _headPadding[_cacheLineSize];
+  QAtomicInt _head; // Next item to pop, written by the consumer
+  char _tailPadding[_cacheLineSize];
+  QAtomicInt _tail; // Next free slot, written by the producer
+  char _flagsPadding[_cacheLineSize];
+  QAtomicInt _parked; // The consumer sleeps or is about to
+  QAtomicInt _interrupted;
+  QMutex _mutex;
+  QWaitCondition _wakeCondition;
+
+  void wakeConsumer();
+};
+
+template <typename T, int Capacity>
+void SpscChannel<T, Capacity>::reset()
+{
+  T value;
+  while (tryPop(value))
+    ;
+  _interrupted.fetchAndStoreOrdered(0);
+}
+
+template <typename T, int Capacity>
+bool SpscChannel<T, Capacity>::tryPush(const T &value)
+{
+  int tail = _tail;
+  int next = (tail + 1) % Capacity;
+  if (next == _head) // Plain read first, cheap while the channel stays full
+    return false;
+  _head.fetchAndAddAcquire(0); // The consumer is done with the slot
+
+  _items[tail] = value;
+  _tail.fetchAndStoreOrdered(next); // Publishes the item
+
+  // Ordered with the consumer storing <_parked> then reading <_tail>: one of both sees the other
+  if (_parked.fetchAndAddOrdered(0))
+    wakeConsumer();
+  return true;
+}
+
+template <typename T, int Capacity>
+bool SpscChannel<T, Capacity>::tryPop(T &value)
+{
+  int head = _head;
+  if (head == _tail) // Plain read first, cheap while spinning on an empty channel
+    return false;
+  _tail.fetchAndAddAcquire(0); // The item written before <_tail> is visible
+
+  value = _items[head];
+  _items[head] = T(); // Don't keep shared data alive
+  _head.fetchAndStoreOrdered((head + 1) % Capacity);
+  return true;
+}
+
+template <typename T, int Capacity>
+int SpscChannel<T, Capacity>::defaultSpinCount()
+{
+  static const int spinCount = QThread::idealThreadCount() > 1 ? 4000 : 0;
+  return spinCount;
+}
+
+template <typename T, int Capacity>
+bool SpscChannel<T, Capacity>::pop(T &value, int spinCount)
+{
+  if (spinCount < 0)
+    spinCount = defaultSpinCount();
+  for (int i = 0; i < spinCount; ++i)
+  {
+    if (_interrupted)
+      return false;
+    if (tryPop(value))
+      return true;
+  }
+
+  QMutexLocker locker(&_mutex);
+  while (true)
+  {
+    _parked.fetchAndStoreOrdered(1);
+    if (_interrupted.fetchAndAddOrdered(0) || tryPop(value))
+      break;
+    _wakeCondition.wait(&_mutex); // A producer can't wake us before, it needs the mutex
+  }
+  _parked.fetchAndStoreOrdered(0);
+  return !_interrupted;
+}
+
+template <typename T, int Capacity>
+void SpscChannel<T, Capacity>::interrupt()
+{
+  _interrupted.fetchAndStoreOrdered(1);
+  wakeConsumer();
+}
+
+template <typename T, int Capacity>
+void SpscChannel<T, Capacity>::wakeConsumer()
+{
+  QMutexLocker locker(&_mutex);
+  _wakeCondition.wakeOne();
+}
+
+// Unbounded lock-free queue between one producer thread and one consumer thread, never waits
+template <typename T>
+class SpscQueue
+{
+public:
+  SpscQueue() : _head(new Node), _tail(_head) {}
+  ~SpscQueue();
+
+  void push(const T &value); // Producer side
+  bool tryPop(T &value); // Consumer side, returns false if the queue is empty
+
+private:
+  Q_DISABLE_COPY(SpscQueue)
+
+  class Node
+  {
+  public:
+    Node(const T &v = T()) : value(v), next(0) {}
+
+    T value;
+    QAtomicPointer<Node> next;
+  };
+
+  Node *_head; // Already popped node, owned by the consumer
+  Node *_tail; // Last pushed node, owned by the producer
+};
+
+template <typename T>
+SpscQueue<T>::~SpscQueue()
+{
+  while (_head)
+  {
+    Node *next = _head->next;
+    delete _head;
+    _head = next;
+  }
+}
+
+template <typename T>
+void SpscQueue<T>::push(const T &value)
+{
+  Node *node = new Node(value);
+  _tail->next.fetchAndStoreRelease(node); // Publishes the value
+  _tail = node;
+}
+
+template <typename T>
+bool SpscQueue<T>::tryPop(T &value)
+{
+  Node *next = _head->next.fetchAndAddAcquire(0);
+  if (!next)
+    return false;
+
+  value = next->value;
+  next->value = T(); // Don't keep shared data alive
+  delete _head;
+  _head = next;
+  return true;
+}
+
+#endif
@@ -1,5 +1,3 @@
-#include "memory.h"
-
 #include "token.h"
 
 Token::Token(TokenType tokenType, int offset) :
@@ -17,11 +15,3 @@ Token::Token(int entity, int offset) :
   _offset(offset)
 {
 }
-
-double Token::value() const
-{
-  if (isVariable())
-    return Memory::instance().variable((int) ((LCDChar) _entity - LCDChar_A));
-  else
-    return _value;
-}
@@ -17,7 +17,7 @@ public:
   Token(int entity, int offset = 0);
 
   TokenType tokenType() const { return _tokenType; }
-  double value() const;
+  double value() const { return _value; } // Number value
   void setValue(double value) { _value = value; }
   int entity() const { return _entity; }
   void setEntity(int entity) { _entity = entity; }